@@ -98,66 +98,65 @@ void loadSSTables() {
     }
 }
 
-vector<KVPair> sortedKVPairs;
+// 归并结果只引用 sstbls 中的 value，不复制字符串
+struct KVRef {
+    int key;
+    int ctime;
+    const string *value;
+};
 
-void sortSSTables() {
-    vector<int> pivot(num, 0);
+vector<KVRef> cleanKVPairs;
 
-    while (1) {
-        int min_pivot_idx = 0;
-        int min_key = INT_MAX;
-        int min_ctime = 0;
-        string min_value;
+// 每个 SSTable 上的一个游标，堆顶是当前最小的 key，key 相同时表号小的在前
+struct Cursor {
+    int key;
+    int table;
+    int pos;
 
-        for (int i = 0; i < num; i++) {
-            if (pivot[i] >= sstbls[i].kv_nums) continue;
+    bool operator>(const Cursor &other) const {
+        return key != other.key ? key > other.key : table > other.table;
+    }
+};
 
-            if (sstbls[i].pairs[pivot[i]].key < min_key) {
-                min_key = sstbls[i].pairs[pivot[i]].key;
-                min_value = sstbls[i].pairs[pivot[i]].value;
-                min_ctime = sstbls[i].pairs[pivot[i]].ctime;
+// 用小根堆做 k 路归并，每输出一个元素 O(log k)。同一 key 的各个版本会连续弹出，
+// 当场保留 ctime 最新的一个（相同时取表号小的），value 为空表示已删除，直接丢弃
+void sortSSTables() {
+    priority_queue<Cursor, vector<Cursor>, greater<Cursor>> heap;
+    for (int i = 0; i < num; i++) {
+        if (sstbls[i].kv_nums > 0) heap.push({sstbls[i].pairs[0].key, i, 0});
+    }
 
-                min_pivot_idx = i;
-            }
+    auto advance = [&](const Cursor &cur) {
+        if (cur.pos + 1 < sstbls[cur.table].kv_nums) {
+            heap.push({sstbls[cur.table].pairs[cur.pos + 1].key, cur.table, cur.pos + 1});
         }
-
-        if (min_key != INT_MAX) {
-            KVPair kvp;
-            kvp.key = min_key;
-            kvp.value = min_value;
-            kvp.ctime = min_ctime;
-            sortedKVPairs.push_back(kvp);
-
-            pivot[min_pivot_idx]++;
-        } else {
-            break;
+    };
+
+    int first_key = 0, last_key = 0;
+    bool empty = heap.empty();
+    if (!empty) first_key = heap.top().key;
+    while (!heap.empty()) {
+        Cursor cur = heap.top();
+        heap.pop();
+        const KVPair *latest = &sstbls[cur.table].pairs[cur.pos];
+        advance(cur);
+        while (!heap.empty() && heap.top().key == cur.key) {
+            Cursor dup = heap.top();
+            heap.pop();
+            const KVPair &kvp = sstbls[dup.table].pairs[dup.pos];
+            if (kvp.ctime > latest->ctime) latest = &kvp;
+            advance(dup);
         }
-    }
-
-    cout << sortedKVPairs[0].key << " " << sortedKVPairs[sortedKVPairs.size() - 1].key << endl;
-}
-
-vector<KVPair> cleanKVPairs;
+        last_key = cur.key;
 
-void cleanSSTables() {
-    KVPair last_latest_kvp = sortedKVPairs[0];
-    for (int i = 0; i < sortedKVPairs.size(); i++) {
-        if (sortedKVPairs[i].key != last_latest_kvp.key) {
-            if (last_latest_kvp.value.size() != 0) {
-                cleanKVPairs.push_back(last_latest_kvp);
-            }
-            last_latest_kvp = sortedKVPairs[i];
-        } else {
-            if (sortedKVPairs[i].ctime > last_latest_kvp.ctime) {
-                last_latest_kvp = sortedKVPairs[i];
-            }
+        if (latest->value.size() != 0) {
+            cleanKVPairs.push_back({latest->key, latest->ctime, &latest->value});
         }
     }
+    if (empty) return;
 
-    if (last_latest_kvp.value.size() != 0) {
-        cleanKVPairs.push_back(last_latest_kvp);
-    }
-
+    cout << first_key << " " << last_key << endl;
+    if (cleanKVPairs.empty()) return;
     cout << cleanKVPairs.size() << " " << cleanKVPairs[0].key << " " << cleanKVPairs[cleanKVPairs.size() - 1].key << endl;
 }
 
@@ -176,10 +175,10 @@ void saveSSTables() {
         fout.write(reinterpret_cast<char *>(&time), 4);
 
         int j = i;
-        while (left_space > (8 + cleanKVPairs[i].value.size()) && i < cleanKVPairs.size()) {
+        while (i < cleanKVPairs.size() && left_space > (8 + cleanKVPairs[i].value->size())) {
             fout.seekp(12 + 8 * (i - j), ios::beg);
             fout.write(reinterpret_cast<char *>(&cleanKVPairs[i].key), 4);
-            left_space -= 8 + cleanKVPairs[i].value.size();
+            left_space -= 8 + cleanKVPairs[i].value->size();
             i++;
         }
 
@@ -189,9 +188,9 @@ void saveSSTables() {
             fout.write(reinterpret_cast<char *>(&off), 4);
 
             fout.seekp(off, ios::beg);
-            fout.write(cleanKVPairs[k].value.c_str(), cleanKVPairs[k].value.size());
+            fout.write(cleanKVPairs[k].value->c_str(), cleanKVPairs[k].value->size());
 
-            off += cleanKVPairs[k].value.size();
+            off += cleanKVPairs[k].value->size();
         }
         fout.seekp(0, ios::beg);
         fout.write(reinterpret_cast<char *>(&off), 4);
@@ -217,8 +216,6 @@ int main() {
 
     sortSSTables();
 
-    cleanSSTables();
-
     saveSSTables();
 
     return 0;
@@ -9,12 +9,175 @@
 #include <stack>
 #include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <cassert>
+#include <cstdint>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using namespace std;
 
 #define INVALID -114514
 
+// 快照文件：SnapshotHeader 后紧跟各个槽位数组的原始字节，加载时直接 mmap 拷回，无需重新哈希
+#define SNAPSHOT_MAGIC 0x50414e5348534148ULL // "HASHSNAP"
+#define SNAPSHOT_VERSION 2
+#define SNAPSHOT_LINEAR 1
+#define SNAPSHOT_CUCKOO 2
+// 哈希函数编号：linear 为 key % size，cuckoo 为 key % size 与 (key / size) % size
+#define SNAPSHOT_HASH_MOD 1
+
+struct SnapshotHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t kind;
+    uint32_t hash_fn;
+    int32_t size;
+    int32_t elems;
+    uint32_t reserved;
+    uint64_t payload_bytes;
+    uint64_t checksum;
+};
+
+struct SnapshotSection {
+    const void *data;
+    size_t bytes;
+};
+
+// 按 4 字节字做 FNV-1a，所有槽位数组都是 int 的整数倍
+struct Checksum {
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    void Update(const void *data, size_t bytes) {
+        assert(bytes % sizeof(uint32_t) == 0);
+        const char *p = static_cast<const char *>(data);
+        for (size_t i = 0; i < bytes; i += sizeof(uint32_t)) {
+            uint32_t w;
+            memcpy(&w, p + i, sizeof(w));
+            h = (h ^ w) * 0x100000001b3ULL;
+        }
+    }
+};
+
+// 校验和覆盖头部（checksum 字段按 0 计）和全部载荷，elems 等字段被改动也能发现
+uint64_t SnapshotChecksum(SnapshotHeader hdr, const vector<SnapshotSection> &sections) {
+    Checksum sum;
+    hdr.checksum = 0;
+    sum.Update(&hdr, sizeof(hdr));
+    for (auto &sec : sections) sum.Update(sec.data, sec.bytes);
+    return sum.h;
+}
+
+bool WriteSnapshot(const string &path, SnapshotHeader hdr, const vector<SnapshotSection> &sections) {
+    hdr.payload_bytes = 0;
+    for (auto &sec : sections) hdr.payload_bytes += sec.bytes;
+    hdr.magic = SNAPSHOT_MAGIC;
+    hdr.version = SNAPSHOT_VERSION;
+    hdr.hash_fn = SNAPSHOT_HASH_MOD;
+    hdr.reserved = 0;
+    hdr.checksum = SnapshotChecksum(hdr, sections);
+
+    // 先写临时文件再 rename，崩溃时不会留下半个快照
+    string tmp = path + ".tmp";
+    ofstream fout(tmp, ios::out | ios::binary | ios::trunc);
+    if (!fout.is_open()) {
+        cerr << "can not open " << tmp << endl;
+        return false;
+    }
+    fout.write(reinterpret_cast<const char *>(&hdr), sizeof(hdr));
+    for (auto &sec : sections) {
+        fout.write(static_cast<const char *>(sec.data), sec.bytes);
+    }
+    fout.close();
+    if (!fout) {
+        cerr << "write snapshot " << tmp << " failed" << endl;
+        return false;
+    }
+    return rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+// 只读映射一个快照文件，校验头部与校验和
+struct MappedSnapshot {
+    void *addr = MAP_FAILED;
+    size_t len = 0;
+    const SnapshotHeader *hdr = NULL;
+    const char *payload = NULL;
+
+    bool Open(const string &path, uint32_t kind) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(SnapshotHeader)) {
+            close(fd);
+            cerr << "snapshot " << path << " truncated" << endl;
+            return false;
+        }
+        len = st.st_size;
+        addr = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (addr == MAP_FAILED) return false;
+
+        hdr = static_cast<const SnapshotHeader *>(addr);
+        payload = static_cast<const char *>(addr) + sizeof(SnapshotHeader);
+        if (hdr->magic != SNAPSHOT_MAGIC || hdr->version != SNAPSHOT_VERSION ||
+            hdr->kind != kind || hdr->hash_fn != SNAPSHOT_HASH_MOD || hdr->size <= 0 ||
+            hdr->elems < 0 || hdr->reserved != 0 || hdr->payload_bytes != len - sizeof(SnapshotHeader)) {
+            cerr << "snapshot " << path << " has bad header" << endl;
+            return false;
+        }
+
+        if (SnapshotChecksum(*hdr, {{payload, hdr->payload_bytes}}) != hdr->checksum) {
+            cerr << "snapshot " << path << " checksum mismatch" << endl;
+            return false;
+        }
+        return true;
+    }
+
+    ~MappedSnapshot() {
+        if (addr != MAP_FAILED) munmap(addr, len);
+    }
+};
+
+// 批量加载用：按 key % size 计数排序，同一个 key 只保留最后一次出现的值。
+// 排序结果写回 kvs，seg[h] 到 seg[h + 1] 是 home 槽位为 h 的一段
+void BucketByHome(vector<pair<int, int>> &kvs, int size, vector<int> &seg) {
+    seg.assign(size + 1, 0);
+    for (auto &kv : kvs) seg[kv.first % size + 1]++;
+    for (int h = 0; h < size; h++) seg[h + 1] += seg[h];
+
+    vector<pair<int, int>> sorted(kvs.size());
+    vector<int> cursor(seg.begin(), seg.end() - 1);
+    for (auto &kv : kvs) sorted[cursor[kv.first % size]++] = kv;
+
+    // 段内去重并压紧，段通常只有一两个元素
+    int w = 0;
+    for (int h = 0; h < size; h++) {
+        int begin = seg[h], end = seg[h + 1];
+        seg[h] = w;
+        for (int i = begin; i < end; i++) {
+            bool dup = false;
+            for (int j = seg[h]; j < w; j++) {
+                if (sorted[j].first == sorted[i].first) {
+                    sorted[j].second = sorted[i].second;
+                    dup = true;
+                    break;
+                }
+            }
+            if (!dup) sorted[w++] = sorted[i];
+        }
+    }
+    seg[size] = w;
+    sorted.resize(w);
+    kvs.swap(sorted);
+}
+
 struct LinearHash {
     vector<pair<int, int>> tbl;
     // 1 for occupied
@@ -130,6 +293,68 @@ struct LinearHash {
             j = (j + 1) % size;
         }
     }
+
+    // 已知 key 集合时一次建表：先按输入规模定好 size，再按 home 顺序线性放置，
+    // 不会反复触发 Enlarge
+    template <typename It>
+    void BulkLoad(It begin, It end) {
+        vector<pair<int, int>> kvs;
+        for (int i = 0; i < size; i++) {
+            if (occupy[i] != 0) kvs.push_back(tbl[i]);
+        }
+        kvs.insert(kvs.end(), begin, end);
+        while ((int)kvs.size() > size / 2) size *= 2;
+
+        vector<int> seg;
+        BucketByHome(kvs, size, seg);
+        tbl.assign(size, {0, 0});
+        occupy.assign(size, 0);
+        elems = kvs.size();
+
+        // cursor 之前的槽位都已占用；越过表尾的条目绕回表头找第一个空位
+        long long cursor = 0;
+        int wrap = 0;
+        for (int h = 0; h < size; h++) {
+            if (cursor < h) cursor = h;
+            for (int i = seg[h]; i < seg[h + 1]; i++) {
+                int pos;
+                if (cursor < size) {
+                    pos = cursor++;
+                } else {
+                    while (occupy[wrap] != 0) wrap++;
+                    pos = wrap;
+                }
+                tbl[pos] = kvs[i];
+                occupy[pos] = 1;
+            }
+        }
+    }
+
+    bool Save(const string &path) const {
+        SnapshotHeader hdr;
+        hdr.kind = SNAPSHOT_LINEAR;
+        hdr.size = size;
+        hdr.elems = elems;
+        return WriteSnapshot(path, hdr, {
+            {tbl.data(), tbl.size() * sizeof(tbl[0])},
+            {occupy.data(), occupy.size() * sizeof(occupy[0])},
+        });
+    }
+
+    bool Load(const string &path) {
+        MappedSnapshot snap;
+        if (!snap.Open(path, SNAPSHOT_LINEAR)) return false;
+
+        size_t n = snap.hdr->size;
+        if (snap.hdr->payload_bytes != n * (sizeof(pair<int, int>) + sizeof(int))) return false;
+        const pair<int, int> *slots = reinterpret_cast<const pair<int, int> *>(snap.payload);
+        const int *occ = reinterpret_cast<const int *>(snap.payload + n * sizeof(pair<int, int>));
+        size = n;
+        elems = snap.hdr->elems;
+        tbl.assign(slots, slots + n);
+        occupy.assign(occ, occ + n);
+        return true;
+    }
 };
 
 struct CuckooHash {
@@ -316,75 +541,366 @@ struct CuckooHash {
             }
         }
     }
+
+    // 离线分配：每个 key 是连接 tbl1[hk1] 与 tbl2[hk2] 的一条边，先剥离度为 1 的槽位，
+    // 剩下的只能是简单环，沿环定向即可；出现度 >= 3 的剩余槽位说明放不下，扩容重来
+    template <typename It>
+    void BulkLoad(It begin, It end) {
+        vector<pair<int, int>> kvs;
+        for (int i = 0; i < size; i++) {
+            if (occupy1[i]) kvs.push_back(tbl1[i]);
+            if (occupy2[i]) kvs.push_back(tbl2[i]);
+        }
+        kvs.insert(kvs.end(), begin, end);
+        while ((int)kvs.size() > size) size *= 2;
+
+        // hk2 = (key / size) % size 在 key 范围远小于 size^2 时会退化，需要继续扩容；
+        // size 超过最大 key 后 hk1 各不相同，一定能放下
+        vector<int> seg;
+        BucketByHome(kvs, size, seg);
+        while (!Assign(kvs)) {
+            assert(size < (1 << 30));
+            size *= 2;
+        }
+    }
+
+    bool Assign(const vector<pair<int, int>> &kvs) {
+        int n = kvs.size();
+        int nodes = 2 * size;
+        // 每个槽位的度数和所连边编号的异或，度为 1 时异或值就是唯一那条边
+        vector<int> deg(nodes, 0);
+        vector<uint32_t> xr(nodes, 0);
+        vector<int> slot(n, -1);
+        auto ends = [&](int e, int &u, int &v) {
+            u = hk1(kvs[e].first);
+            v = size + hk2(kvs[e].first);
+        };
+        for (int e = 0; e < n; e++) {
+            int u, v;
+            ends(e, u, v);
+            deg[u]++, xr[u] ^= e;
+            deg[v]++, xr[v] ^= e;
+        }
+
+        vector<int> peel;
+        for (int x = 0; x < nodes; x++) {
+            if (deg[x] == 1) peel.push_back(x);
+        }
+        while (!peel.empty()) {
+            int x = peel.back();
+            peel.pop_back();
+            if (deg[x] != 1) continue;
+            int e = xr[x];
+            int u, v;
+            ends(e, u, v);
+            int other = (u == x) ? v : u;
+            slot[e] = x;
+            deg[x] = 0;
+            deg[other]--, xr[other] ^= e;
+            if (deg[other] == 1) peel.push_back(other);
+        }
+
+        for (int x = 0; x < nodes; x++) {
+            if (deg[x] > 2) return false;
+        }
+        // 剩余部分每个槽位度为 2，沿环把每条边分给它前进方向的槽位
+        for (int e = 0; e < n; e++) {
+            if (slot[e] != -1) continue;
+            int u, v;
+            ends(e, u, v);
+            int cur_e = e, cur_x = v;
+            do {
+                slot[cur_e] = cur_x;
+                int next_e = xr[cur_x] ^ cur_e;
+                ends(next_e, u, v);
+                cur_x = (u == cur_x) ? v : u;
+                cur_e = next_e;
+            } while (cur_e != e);
+        }
+
+        tbl1.assign(size, {0, 0});
+        tbl2.assign(size, {0, 0});
+        occupy1.assign(size, 0);
+        occupy2.assign(size, 0);
+        for (int e = 0; e < n; e++) {
+            if (slot[e] < size) {
+                tbl1[slot[e]] = kvs[e];
+                occupy1[slot[e]] = 1;
+            } else {
+                tbl2[slot[e] - size] = kvs[e];
+                occupy2[slot[e] - size] = 1;
+            }
+        }
+        return true;
+    }
+
+    bool Save(const string &path) const {
+        SnapshotHeader hdr;
+        hdr.kind = SNAPSHOT_CUCKOO;
+        hdr.size = size;
+        hdr.elems = 0;
+        return WriteSnapshot(path, hdr, {
+            {tbl1.data(), tbl1.size() * sizeof(tbl1[0])},
+            {tbl2.data(), tbl2.size() * sizeof(tbl2[0])},
+            {occupy1.data(), occupy1.size() * sizeof(occupy1[0])},
+            {occupy2.data(), occupy2.size() * sizeof(occupy2[0])},
+        });
+    }
+
+    bool Load(const string &path) {
+        MappedSnapshot snap;
+        if (!snap.Open(path, SNAPSHOT_CUCKOO)) return false;
+
+        size_t n = snap.hdr->size;
+        if (snap.hdr->payload_bytes != 2 * n * (sizeof(pair<int, int>) + sizeof(int))) return false;
+        const pair<int, int> *slots1 = reinterpret_cast<const pair<int, int> *>(snap.payload);
+        const pair<int, int> *slots2 = slots1 + n;
+        const int *occ1 = reinterpret_cast<const int *>(slots2 + n);
+        const int *occ2 = occ1 + n;
+        size = n;
+        tbl1.assign(slots1, slots1 + n);
+        tbl2.assign(slots2, slots2 + n);
+        occupy1.assign(occ1, occ1 + n);
+        occupy2.assign(occ2, occ2 + n);
+        return true;
+    }
+};
+
+// 分片哈希表：用 key 混合后的高位选分片，每个分片有自己的锁和底层表，
+// 扩容只发生在单个分片内，不会阻塞其他分片
+template <typename Table>
+struct ShardedHash {
+    struct Shard {
+        mutex mtx;
+        Table tbl;
+        // 按缓存行隔开相邻分片的锁，避免伪共享
+        char pad[64];
+
+        Shard() : tbl(8) {}
+    };
+
+    int shard_bits;
+    // mutex 不能移动，分片单独分配
+    vector<unique_ptr<Shard>> shards;
+
+    ShardedHash(int bits) : shard_bits(bits) {
+        assert(bits >= 1 && bits <= 16);
+        for (int i = 0; i < (1 << bits); i++) {
+            shards.emplace_back(new Shard());
+        }
+    }
+
+    int ShardOf(int key) const {
+        // 底层表用 key % size 取低位，这里取乘法混合后的高位，两者互不干扰
+        uint32_t h = (uint32_t)key * 0x9E3779B1u;
+        return h >> (32 - shard_bits);
+    }
+
+    Shard &Pick(int key) {
+        return *shards[ShardOf(key)];
+    }
+
+    int Get(int key) {
+        Shard &sh = Pick(key);
+        lock_guard<mutex> lk(sh.mtx);
+        return sh.tbl.Get(key);
+    }
+
+    void Set(int key, int value) {
+        Shard &sh = Pick(key);
+        lock_guard<mutex> lk(sh.mtx);
+        sh.tbl.Set(key, value);
+    }
+
+    void Del(int key) {
+        Shard &sh = Pick(key);
+        lock_guard<mutex> lk(sh.mtx);
+        sh.tbl.Del(key);
+    }
+
+    template <typename It>
+    void BulkLoad(It begin, It end) {
+        vector<vector<pair<int, int>>> parts(shards.size());
+        for (It it = begin; it != end; ++it) {
+            parts[ShardOf(it->first)].push_back(*it);
+        }
+        for (size_t i = 0; i < shards.size(); i++) {
+            lock_guard<mutex> lk(shards[i]->mtx);
+            shards[i]->tbl.BulkLoad(parts[i].begin(), parts[i].end());
+        }
+    }
 };
 
+// 混合 Get/Set 负载，返回每秒百万次操作数
+template <typename Table>
+double BenchSharded(int threads, int shard_bits, int ops_per_thread, int key_range, int set_percent) {
+    ShardedHash<Table> map(shard_bits);
+    for (int k = 0; k < key_range; k += 2) {
+        map.Set(k, k);
+    }
+
+    vector<thread> workers;
+    auto start = chrono::steady_clock::now();
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&map, t, ops_per_thread, key_range, set_percent]() {
+            uint64_t x = 0x2545F4914F6CDD1DULL ^ (uint64_t)(t + 1) * 0x9E3779B97F4A7C15ULL;
+            for (int i = 0; i < ops_per_thread; i++) {
+                x ^= x << 13;
+                x ^= x >> 7;
+                x ^= x << 17;
+                int key = (int)((x >> 8) % key_range);
+                if ((int)(x % 100) < set_percent) {
+                    map.Set(key, i);
+                } else {
+                    map.Get(key);
+                }
+            }
+        });
+    }
+    for (auto &w : workers) w.join();
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return (double)threads * ops_per_thread / secs / 1e6;
+}
+
+void Benchmark() {
+    const int shard_bits = 8;
+    const int ops_per_thread = 1 << 20;
+    const int key_range = 1 << 22;
+    const int set_percent = 20;
+    cout << "threads linear(Mops/s) cuckoo(Mops/s)" << endl;
+    for (int threads = 1; threads <= 32; threads *= 2) {
+        double lin = BenchSharded<LinearHash>(threads, shard_bits, ops_per_thread, key_range, set_percent);
+        double cuc = BenchSharded<CuckooHash>(threads, shard_bits, ops_per_thread, key_range, set_percent);
+        cout << threads << " " << lin << " " << cuc << endl;
+    }
+}
+
+void BenchmarkBulk() {
+    cout << "keys linear-set(s) linear-bulk(s) cuckoo-set(s) cuckoo-bulk(s)" << endl;
+    for (int n = 1 << 16; n <= (1 << 22); n <<= 2) {
+        // 打乱的 0..n-1：两种哈希函数在这种 key 上都不会退化
+        vector<pair<int, int>> kvs(n);
+        for (int i = 0; i < n; i++) {
+            kvs[i] = {i, i};
+        }
+        shuffle(kvs.begin(), kvs.end(), mt19937(n));
+
+        double t[4];
+        for (int k = 0; k < 4; k++) {
+            auto start = chrono::steady_clock::now();
+            if (k == 0) {
+                LinearHash tbl(8);
+                for (auto &kv : kvs) tbl.Set(kv.first, kv.second);
+            } else if (k == 1) {
+                LinearHash tbl(8);
+                tbl.BulkLoad(kvs.begin(), kvs.end());
+            } else if (k == 2) {
+                CuckooHash tbl(8);
+                for (auto &kv : kvs) tbl.Set(kv.first, kv.second);
+            } else {
+                CuckooHash tbl(8);
+                tbl.BulkLoad(kvs.begin(), kvs.end());
+            }
+            t[k] = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        }
+        cout << n << " " << t[0] << " " << t[1] << " " << t[2] << " " << t[3] << endl;
+    }
+}
+
+template <typename Table>
+void Replay(Table &tbl, ifstream &fin, ofstream &fout) {
+    // 日志开头连续的 Set 在任何 Get/Del 之前，攒起来一次 BulkLoad
+    vector<pair<int, int>> pending;
+    bool leading = true;
+    string line;
+    while (getline(fin, line)) {
+        stringstream ss(line);
+        string op;
+        ss >> op;
+        if (op == "Set") {
+            string key, value;
+            ss >> key >> value;
+            if (leading) {
+                pending.push_back({stoi(key), stoi(value)});
+            } else {
+                tbl.Set(stoi(key), stoi(value));
+            }
+            continue;
+        }
+        if (leading) {
+            tbl.BulkLoad(pending.begin(), pending.end());
+            pending.clear();
+            leading = false;
+        }
+        if (op == "Get") {
+            string key;
+            ss >> key;
+            int value = tbl.Get(stoi(key));
+            if (value != INVALID) {
+                fout << value << endl;
+            } else {
+                fout << "null" << endl;
+            }
+        } else if (op == "Del") {
+            string key;
+            ss >> key;
+            tbl.Del(stoi(key));
+        } else {
+            assert(false);
+        }
+    }
+    if (leading) {
+        tbl.BulkLoad(pending.begin(), pending.end());
+    }
+}
+
+// 有快照时先从快照恢复，再回放之后追加的命令日志，结束时重新写快照
+template <typename Table>
+void Run(Table &tbl, ifstream &fin, ofstream &fout, const string &snapshot_path) {
+    if (!snapshot_path.empty() && !tbl.Load(snapshot_path)) {
+        cerr << "start without snapshot " << snapshot_path << endl;
+    }
+    Replay(tbl, fin, fout);
+    if (!snapshot_path.empty() && !tbl.Save(snapshot_path)) {
+        cerr << "save snapshot " << snapshot_path << " failed" << endl;
+    }
+}
+
 int main(int argc, char* argv[]) {
     string mode;
     cin >> mode;
+    if (mode == "bench") {
+        Benchmark();
+        return 0;
+    }
+    if (mode == "bench-bulk") {
+        BenchmarkBulk();
+        return 0;
+    }
     string input_path;
     cin >> input_path;
+    // 可选：快照文件路径
+    string snapshot_path;
+    cin >> snapshot_path;
     ifstream fin(input_path);
 
     if (!fin.is_open()) assert(false);
 
-    string line;
     ofstream fout("ans");
     if (mode == "linear") {
         LinearHash ltbl(8);
-        while (getline(fin, line)) {
-            stringstream ss(line);
-            string op;
-            ss >> op;
-            if (op == "Set") {
-                string key, value;
-                ss >> key >> value;
-                ltbl.Set(stoi(key), stoi(value));
-            } else if (op == "Get") {
-                string key;
-                ss >> key;
-                int value = ltbl.Get(stoi(key));
-                if (value != INVALID) {
-                    fout << value << endl;
-                } else {
-                    fout << "null" << endl;
-                }
-            } else if (op == "Del") {
-                string key;
-                ss >> key;
-                ltbl.Del(stoi(key));
-            } else {
-                assert(false);
-            }
-        }
+        Run(ltbl, fin, fout, snapshot_path);
     } else if (mode == "cuckoo") {
         CuckooHash ltbl(8);
-        while (getline(fin, line)) {
-            stringstream ss(line);
-            string op;
-            ss >> op;
-            if (op == "Set") {
-                string key, value;
-                ss >> key >> value;
-                ltbl.Set(stoi(key), stoi(value));
-            } else if (op == "Get") {
-                string key;
-                ss >> key;
-                int value = ltbl.Get(stoi(key));
-                if (value != INVALID) {
-                    fout << value << endl;
-                } else {
-                    fout << "null" << endl;
-                }
-            } else if (op == "Del") {
-                string key;
-                ss >> key;
-                ltbl.Del(stoi(key));
-            } else {
-                assert(false);
-            }
-        }
+        Run(ltbl, fin, fout, snapshot_path);
+    } else if (mode == "sharded-linear") {
+        ShardedHash<LinearHash> ltbl(4);
+        Replay(ltbl, fin, fout);
+    } else if (mode == "sharded-cuckoo") {
+        ShardedHash<CuckooHash> ltbl(4);
+        Replay(ltbl, fin, fout);
     } else {
         cerr << mode << endl;
     }
     return 0;
-}
\ No newline at end of file
+}
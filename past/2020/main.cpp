@@ -10,85 +10,136 @@
 #include <algorithm>
 #include <cmath>
 #include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <memory>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using namespace std;
 
 string txt, idx, zip;
 
-unordered_map<char, int> freqTable;
+// 四组计数交错累加，相邻的相同字节不会落在同一个计数器上形成写后读依赖
+void count_bytes(const unsigned char *p, size_t n, uint64_t counts[256]) {
+    uint32_t c[4][256];
+    memset(c, 0, sizeof(c));
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        c[0][p[i]]++;
+        c[1][p[i + 1]]++;
+        c[2][p[i + 2]]++;
+        c[3][p[i + 3]]++;
+    }
+    for (; i < n; i++) c[0][p[i]]++;
+    for (int k = 0; k < 256; k++) counts[k] += (uint64_t)c[0][k] + c[1][k] + c[2][k] + c[3][k];
+}
 
-void do_statistics() {
-    ifstream fin(txt);
+// 字节直方图：按 HIST_WINDOW 大小的窗口 mmap 输入文件，用 count_bytes 累加，
+// do_statistics、build_tree 和限长码长都从这里取频数。
+// 同一时刻只映射一个窗口，第一遍的常驻内存不随输入增大
+#define HIST_WINDOW (4 << 20)
 
-    if (!fin.is_open()) {
-        assert(false);
-    }
+struct ByteHistogram {
+    uint64_t counts[256];
+    uint64_t total;
+    double seconds;
 
-    char ch;
-    int cnt = 0;
-    while (fin.get(ch)) {
-        if (freqTable.find(ch) == freqTable.end()) {
-            freqTable[ch] = 1;
-            cnt++;
-        } else {
-            freqTable[ch]++;
+    bool CountFile(const string &path) {
+        memset(counts, 0, sizeof(counts));
+        total = 0;
+        auto start = chrono::steady_clock::now();
+
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            return false;
+        }
+        uint64_t size = st.st_size;
+        for (uint64_t off = 0; off < size; off += HIST_WINDOW) {
+            size_t len = min<uint64_t>(HIST_WINDOW, size - off);
+            void *addr = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, off);
+            if (addr == MAP_FAILED) {
+                close(fd);
+                return false;
+            }
+            madvise(addr, len, MADV_SEQUENTIAL);
+            count_bytes(static_cast<const unsigned char*>(addr), len, counts);
+            munmap(addr, len);
         }
+        close(fd);
+        total = size;
+        seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        return true;
     }
 
-    int max0 = 0;
-    char maxch0;
-    for (auto kv : freqTable) {
-        if (kv.second > max0 || (kv.second == max0 && kv.first < maxch0)) {
-            max0 = kv.second;
-            maxch0 = kv.first;
-        }
+    int Distinct() const {
+        int n = 0;
+        for (int c = 0; c < 256; c++) n += counts[c] != 0;
+        return n;
     }
 
-    int max1 = 0;
-    char maxch1;
-    for (auto kv : freqTable) {
-        if (kv.second == max0 && kv.first == maxch0) continue;
-        if (kv.second > max1 || (kv.second == max1 && kv.first < maxch1)) {
-            max1 = kv.second;
-            maxch1 = kv.first;
+    // 出现次数降序、字节值升序的前 k 个（次数, 字节）
+    vector<pair<uint64_t, int>> TopK(int k) const {
+        vector<pair<uint64_t, int>> items;
+        for (int c = 0; c < 256; c++) {
+            if (counts[c]) items.push_back({counts[c], c});
         }
+        k = min<int>(k, items.size());
+        partial_sort(items.begin(), items.begin() + k, items.end(), [](const pair<uint64_t, int> &a, const pair<uint64_t, int> &b) {
+            return a.first != b.first ? a.first > b.first : a.second < b.second;
+        });
+        items.resize(k);
+        return items;
     }
+};
 
-    int max2 = 0;
-    char maxch2;
-    for (auto kv : freqTable) {
-        if (kv.second > max1 || (kv.second == max1 && kv.first == maxch1)) continue;
-        if (kv.second > max2 || (kv.second == max2 && kv.first < maxch2)) {
-            max2 = kv.second;
-            maxch2 = kv.first;
-        }
+ByteHistogram histogram;
+
+void do_statistics() {
+    if (!histogram.CountFile(txt)) {
+        assert(false);
     }
 
-    cout << cnt << endl << maxch0 << " " << max0 << endl << maxch1 << " " << max1 << endl << maxch2 << " " << max2 << endl;
+    cout << histogram.Distinct() << endl;
+    for (auto &e : histogram.TopK(3)) {
+        cout << (char)e.second << " " << e.first << endl;
+    }
 }
 
 struct HFTREE {
     char asc;
-    int w;
+    long long w;
     int h;
 
     HFTREE* lchild;
     HFTREE* rchild;
 
-    HFTREE(char ascii, int weight) : asc(ascii), w(weight), h(0), lchild(NULL), rchild(NULL) {}
+    HFTREE(char ascii, long long weight) : asc(ascii), w(weight), h(0), lchild(NULL), rchild(NULL) {}
 };
 
 // pair of weight, ascii
-typedef pair<int, int> PII;
+typedef pair<long long, int> PII;
 typedef pair<PII, HFTREE*> PPH;
 priority_queue<PPH, vector<PPH>, greater<PPH>> pq;
 
 HFTREE* huffmanTree;
 
 void build_tree() {
-    for (auto kv : freqTable) {
-        HFTREE* hf = new HFTREE(kv.first, kv.second);
-        pq.push({{kv.second, kv.first}, hf});
+    for (int c = 0; c < 256; c++) {
+        if (histogram.counts[c] == 0) continue;
+        // 同权重时按有符号 char 比较，与原来的树保持一致
+        HFTREE* hf = new HFTREE((char)c, histogram.counts[c]);
+        pq.push({{(long long)histogram.counts[c], (char)c}, hf});
     }
 
     while (pq.size() > 1) {
@@ -98,9 +149,9 @@ void build_tree() {
         pq.pop();
 
         char asc = min(p1.first.second, p2.first.second);
-        int w = p1.first.first + p2.first.first;
+        long long w = p1.first.first + p2.first.first;
 
-        HFTREE* hf = new HFTREE(w, asc);
+        HFTREE* hf = new HFTREE(asc, w);
         hf->lchild = p1.second;
         hf->rchild = p2.second;
         hf->h = max(p1.second->h, p2.second->h) + 1;
@@ -129,52 +180,1291 @@ void encode(HFTREE* node) {
     }
 }
 
+// 按位输出：码字先放进 64 位累加器（高位先写），攒满一个字再按大端写进缓冲区，
+// 缓冲区满了才落盘；最后不足一字节的部分补 0
+struct BitWriter {
+    ostream &fout;
+    vector<unsigned char> buf;
+    size_t pos;
+    uint64_t acc;
+    int nbits;
+    long long bits;
+
+    BitWriter(ostream &out) : fout(out), buf(1 << 16), pos(0), acc(0), nbits(0), bits(0) {}
+
+    void Put(uint64_t code, int len) {
+        if (len == 0) return;
+        bits += len;
+        int room = 64 - nbits;
+        if (len < room) {
+            acc |= code << (room - len);
+            nbits += len;
+            return;
+        }
+        acc |= code >> (len - room);
+        PutWord(acc);
+        len -= room;
+        acc = len ? code << (64 - len) : 0;
+        nbits = len;
+    }
+
+    void PutWord(uint64_t w) {
+        if (pos + 8 > buf.size()) Flush();
+        for (int i = 0; i < 8; i++) {
+            buf[pos++] = (unsigned char)(w >> (56 - 8 * i));
+        }
+    }
+
+    void Flush() {
+        fout.write(reinterpret_cast<const char*>(buf.data()), pos);
+        pos = 0;
+    }
+
+    void Finish() {
+        if (pos + 8 > buf.size()) Flush();
+        for (int i = 0; i < nbits; i += 8) {
+            buf[pos++] = (unsigned char)(acc >> (56 - i));
+        }
+        acc = 0;
+        nbits = 0;
+        Flush();
+    }
+};
+
+// 第二遍：输入经固定大小的缓冲区读入，比特流经 BitWriter 的缓冲区写出，
+// 结束后把有效比特数回填到 bitsPos；内存占用与输入大小无关
+long long encode_stream(const string &path, const bool known[256], const uint64_t codes[256],
+                        const int lens[256], ofstream &fout, streampos bitsPos) {
+    ifstream fin(path, ios::binary);
+    if (!fin.is_open()) {
+        cerr << "can not open " << path << endl;
+        return -1;
+    }
+
+    BitWriter writer(fout);
+    vector<char> inbuf(1 << 16);
+    while (fin.read(inbuf.data(), inbuf.size()) || fin.gcount() > 0) {
+        streamsize n = fin.gcount();
+        for (streamsize i = 0; i < n; i++) {
+            unsigned char c = inbuf[i];
+            if (!known[c]) {
+                cerr << "byte " << (int)c << " has no code" << endl;
+                return -1;
+            }
+            writer.Put(codes[c], lens[c]);
+        }
+    }
+    writer.Finish();
+
+    long long validBits = writer.bits;
+    streampos end = fout.tellp();
+    fout.seekp(bitsPos);
+    fout.write(reinterpret_cast<const char*>(&validBits), sizeof(validBits));
+    fout.seekp(end);
+    return validBits;
+}
+
 void compress() {
-    ifstream fin(txt);
-    char ch;
+    // 码表展开成按字节下标的数组，码长不超过 64
+    bool known[256] = {false};
+    uint64_t codes[256] = {0};
+    int lens[256] = {0};
+    for (auto kv : codingTable) {
+        unsigned char c = kv.first;
+        assert(kv.second.length() <= 64);
+        known[c] = true;
+        lens[c] = kv.second.length();
+        for (char b : kv.second) {
+            codes[c] = (codes[c] << 1) | (b == '1');
+        }
+    }
 
-    string bitstream = "";
-    while(fin.get(ch)) {
-        if (codingTable.find(ch) == codingTable.end()) {
-            assert(false);
+    ofstream fout(zip, ios::binary);
+
+    // 先占位，写完比特流后回填有效比特数
+    long long validBits = 0;
+    fout.write(reinterpret_cast<const char*>(&validBits), sizeof(validBits));
+    validBits = encode_stream(txt, known, codes, lens, fout, 0);
+    if (validBits < 0) {
+        assert(false);
+    }
+    fout.close();
+
+    cout << validBits << endl;
+}
+
+// 读取 .huffidx：每行是「字符 空格 码字」，字符本身可能是空格或换行，所以按字节解析
+bool load_coding_table() {
+    ifstream fin(idx, ios::binary);
+    if (!fin.is_open()) {
+        cerr << "can not open " << idx << endl;
+        return false;
+    }
+
+    codingTable.clear();
+    char ch, sp;
+    while (fin.get(ch) && fin.get(sp)) {
+        string code;
+        getline(fin, code);
+        if (sp != ' ' || code.find_first_not_of("01") != string::npos) {
+            cerr << "bad code table " << idx << endl;
+            return false;
+        }
+        codingTable[ch] = code;
+    }
+    return true;
+}
+
+// 多级查找表：每级最多用 DECODE_BITS 位做下标。叶子项直接给出字符和码长，
+// 链接项指向下一级子表，码长超过一级宽度的码字在子表里继续解析
+#define DECODE_BITS 11
+
+struct DecodeEntry {
+    uint32_t val;     // 叶子：字符；链接：子表在 entries 中的起点
+    uint8_t len;      // 叶子：本级消耗的比特数；0 表示无效前缀
+    uint8_t subBits;  // 链接：子表下标宽度；叶子为 0
+};
+
+struct DecodeTable {
+    vector<DecodeEntry> entries;
+    int rootBits;
+
+    // codes 中的码字共享前 depth 位，返回为它们建立的表的起点
+    uint32_t Build(vector<pair<string, unsigned char>> &codes, int depth, int &bits) {
+        int maxRest = 0;
+        for (auto &c : codes) maxRest = max(maxRest, (int)c.first.length() - depth);
+        bits = min(DECODE_BITS, max(maxRest, 1));
+
+        uint32_t base = entries.size();
+        entries.resize(base + (1u << bits), DecodeEntry{0, 0, 0});
+
+        map<uint32_t, vector<pair<string, unsigned char>>> longer;
+        for (auto &c : codes) {
+            int rest = c.first.length() - depth;
+            uint32_t idx = 0;
+            for (int i = 0; i < min(rest, bits); i++) {
+                idx = (idx << 1) | (c.first[depth + i] == '1');
+            }
+            if (rest <= bits) {
+                idx <<= bits - rest;
+                for (uint32_t k = 0; k < (1u << (bits - rest)); k++) {
+                    entries[base + idx + k] = DecodeEntry{c.second, (uint8_t)rest, 0};
+                }
+            } else {
+                longer[idx].push_back(c);
+            }
+        }
+
+        for (auto &kv : longer) {
+            int subBits;
+            uint32_t sub = Build(kv.second, depth + bits, subBits);
+            entries[base + kv.first] = DecodeEntry{sub, (uint8_t)bits, (uint8_t)subBits};
+        }
+        return base;
+    }
+
+    void Init(const map<char, string> &table) {
+        vector<pair<string, unsigned char>> codes;
+        for (auto kv : table) codes.push_back({kv.second, (unsigned char)kv.first});
+        entries.clear();
+        Build(codes, 0, rootBits);
+    }
+};
+
+// 按位读取：缓冲区里的比特左对齐放在 64 位字中，不足 57 位时逐字节补充
+struct BitReader {
+    istream &fin;
+    vector<unsigned char> buf;
+    size_t pos, end;
+    uint64_t acc;
+    int nbits;
+
+    BitReader(istream &in) : fin(in), buf(1 << 16), pos(0), end(0), acc(0), nbits(0) {}
+
+    void Refill() {
+        while (nbits <= 56) {
+            if (pos == end) {
+                fin.read(reinterpret_cast<char*>(buf.data()), buf.size());
+                end = fin.gcount();
+                pos = 0;
+                // 文件结束后用 0 补齐，只会落在填充位上
+                if (end == 0) return;
+            }
+            acc |= (uint64_t)buf[pos++] << (56 - nbits);
+            nbits += 8;
+        }
+    }
+
+    uint32_t Peek(int n) {
+        return (uint32_t)(acc >> (64 - n));
+    }
+
+    void Skip(int n) {
+        acc <<= n;
+        nbits -= n;
+    }
+};
+
+void decompress() {
+    if (!load_coding_table()) return;
+    // 先检查再打开输出文件，出错时不会把已有的 txt 截成空文件
+    if (codingTable.size() == 1) {
+        // 只有一种字符时码长为 0，文件里没有记录字符个数，无法还原
+        cerr << "single-symbol table carries no length information" << endl;
+        return;
+    }
+
+    ifstream fin(zip, ios::binary);
+    if (!fin.is_open()) {
+        cerr << "can not open " << zip << endl;
+        return;
+    }
+    long long validBits = 0;
+    fin.read(reinterpret_cast<char*>(&validBits), sizeof(validBits));
+
+    ofstream fout(txt, ios::binary);
+
+    auto start = chrono::steady_clock::now();
+    DecodeTable table;
+    table.Init(codingTable);
+
+    BitReader reader(fin);
+    vector<char> outbuf(1 << 16);
+    size_t outpos = 0;
+    long long outBytes = 0;
+    long long remaining = validBits;
+    while (remaining > 0) {
+        reader.Refill();
+        uint32_t base = 0;
+        int bits = table.rootBits;
+        while (true) {
+            if (reader.nbits < bits) reader.Refill();
+            const DecodeEntry &e = table.entries[base + reader.Peek(bits)];
+            if (e.len == 0 || e.len > remaining) {
+                cerr << "corrupt stream at bit " << validBits - remaining << endl;
+                remaining = 0;
+                break;
+            }
+            reader.Skip(e.len);
+            remaining -= e.len;
+            if (e.subBits == 0) {
+                outbuf[outpos++] = (char)e.val;
+                if (outpos == outbuf.size()) {
+                    fout.write(outbuf.data(), outpos);
+                    outBytes += outpos;
+                    outpos = 0;
+                }
+                break;
+            }
+            base = e.val;
+            bits = e.subBits;
+        }
+    }
+    fout.write(outbuf.data(), outpos);
+    outBytes += outpos;
+    fout.close();
+
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << outBytes << endl;
+    cout << "decode " << (secs > 0 ? outBytes / secs / 1e6 : 0) << " MB/s" << endl;
+}
+
+// 范式哈夫曼：只保存每个字符的码长，码字按 (码长, 字符) 顺序依次分配。
+// .huffzip 头部为 4 字节魔数、8 字节有效比特数、256 字节码长（0 表示未出现），
+// 不再需要 .huffidx
+#define CANONICAL_MAGIC "HFCN"
+#define CANONICAL_MAX_LEN 64
+
+struct CanonicalCode {
+    int lens[256];
+    uint64_t codes[256];
+    int maxLen;
+    // 按 (码长, 字符) 排好的字符，以及每个码长的首个码字、个数和在 sorted 中的起点
+    unsigned char sorted[256];
+    int nsyms;
+    uint64_t first[CANONICAL_MAX_LEN + 1];
+    int count[CANONICAL_MAX_LEN + 1];
+    int offset[CANONICAL_MAX_LEN + 1];
+
+    // 由码长分配码字，O(字符集 + 最大码长)
+    bool Assign() {
+        maxLen = 0;
+        memset(count, 0, sizeof(count));
+        for (int c = 0; c < 256; c++) {
+            if (lens[c] < 0 || lens[c] > CANONICAL_MAX_LEN) return false;
+            count[lens[c]]++;
+            maxLen = max(maxLen, lens[c]);
+        }
+        count[0] = 0;
+
+        uint64_t code = 0;
+        int idx = 0;
+        for (int l = 1; l <= CANONICAL_MAX_LEN; l++) {
+            code <<= 1;
+            first[l] = code;
+            offset[l] = idx;
+            idx += count[l];
+            // 超出该码长能容纳的码字个数，说明码长不满足 Kraft 不等式
+            if (l < 64 && count[l] > 0 && code + count[l] > (1ULL << l)) return false;
+            code += count[l];
+        }
+        nsyms = idx;
+
+        int next[CANONICAL_MAX_LEN + 1];
+        memcpy(next, offset, sizeof(next));
+        for (int c = 0; c < 256; c++) {
+            if (lens[c] == 0) continue;
+            int l = lens[c];
+            codes[c] = first[l] + (next[l] - offset[l]);
+            sorted[next[l]++] = c;
+        }
+        return true;
+    }
+};
+
+void tree_code_lengths(HFTREE* node, int depth, int lens[256]) {
+    if (node->lchild == NULL) {
+        // 只有一个字符时根就是叶子，仍给它 1 位码长，解码时才能数出字符个数
+        lens[(unsigned char)node->asc] = max(depth, 1);
+    } else {
+        tree_code_lengths(node->lchild, depth + 1, lens);
+        tree_code_lengths(node->rchild, depth + 1, lens);
+    }
+}
+
+// package-merge：在最大码长不超过 limit 的前提下求总长度最小的码长。
+// 每一轮把上一轮列表两两打包，再与叶子按权重归并；最后取前 2n-2 项，
+// 每个叶子在其中出现的次数就是它的码长
+bool limited_code_lengths(const uint64_t counts[256], int limit, int lens[256]) {
+    struct PMNode {
+        long long w;
+        int sym;
+        int left, right;
+    };
+    vector<PMNode> pool;
+    for (int c = 0; c < 256; c++) {
+        if (counts[c]) pool.push_back({(long long)counts[c], c, -1, -1});
+    }
+    int n = pool.size();
+    memset(lens, 0, 256 * sizeof(int));
+    if (n == 0) return true;
+    if (n == 1) {
+        lens[pool[0].sym] = 1;
+        return true;
+    }
+    if (limit < 1 || limit > CANONICAL_MAX_LEN || (limit < 31 && (1 << limit) < n)) return false;
+
+    sort(pool.begin(), pool.end(), [](const PMNode &a, const PMNode &b) {
+        return a.w != b.w ? a.w < b.w : a.sym < b.sym;
+    });
+    vector<int> leaves(n);
+    for (int i = 0; i < n; i++) leaves[i] = i;
+
+    vector<int> cur = leaves;
+    for (int level = 1; level < limit; level++) {
+        vector<int> packages;
+        for (size_t i = 0; i + 1 < cur.size(); i += 2) {
+            pool.push_back({pool[cur[i]].w + pool[cur[i + 1]].w, -1, cur[i], cur[i + 1]});
+            packages.push_back(pool.size() - 1);
+        }
+        vector<int> merged;
+        merged.reserve(leaves.size() + packages.size());
+        size_t a = 0, b = 0;
+        while (a < leaves.size() || b < packages.size()) {
+            if (b == packages.size() || (a < leaves.size() && pool[leaves[a]].w <= pool[packages[b]].w)) {
+                merged.push_back(leaves[a++]);
+            } else {
+                merged.push_back(packages[b++]);
+            }
+        }
+        cur.swap(merged);
+    }
+
+    vector<int> stk(cur.begin(), cur.begin() + (2 * n - 2));
+    while (!stk.empty()) {
+        int x = stk.back();
+        stk.pop_back();
+        if (pool[x].sym >= 0) {
+            lens[pool[x].sym]++;
         } else {
-            bitstream += codingTable[ch];
+            stk.push_back(pool[x].left);
+            stk.push_back(pool[x].right);
+        }
+    }
+    return true;
+}
+
+long long compress_canonical(const CanonicalCode &cc) {
+    ofstream fout(zip, ios::binary);
+
+    long long validBits = 0;
+    fout.write(CANONICAL_MAGIC, 4);
+    fout.write(reinterpret_cast<const char*>(&validBits), sizeof(validBits));
+    unsigned char header[256];
+    bool known[256];
+    for (int c = 0; c < 256; c++) {
+        header[c] = cc.lens[c];
+        known[c] = cc.lens[c] > 0;
+    }
+    fout.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+    validBits = encode_stream(txt, known, cc.codes, cc.lens, fout, 4);
+    fout.close();
+    return validBits;
+}
+
+// 短码用 DECODE_BITS 位的直接查找表；更长的码字利用范式码的单调性，
+// 把窗口与每个码长的左对齐上界比较来确定码长
+struct CanonicalDecoder {
+    const CanonicalCode &cc;
+    uint16_t fast[1 << DECODE_BITS];  // 低 8 位字符，高 8 位码长，0 表示码长超过 DECODE_BITS
+    uint64_t limit[CANONICAL_MAX_LEN + 1];
+
+    CanonicalDecoder(const CanonicalCode &code) : cc(code) {
+        memset(fast, 0, sizeof(fast));
+        for (int i = 0; i < cc.nsyms; i++) {
+            unsigned char c = cc.sorted[i];
+            int l = cc.lens[c];
+            if (l > DECODE_BITS) break;
+            uint32_t lo = cc.codes[c] << (DECODE_BITS - l);
+            uint32_t hi = lo + (1u << (DECODE_BITS - l));
+            for (uint32_t k = lo; k < hi; k++) fast[k] = (uint16_t)(l << 8 | c);
+        }
+        for (int l = 1; l <= CANONICAL_MAX_LEN; l++) {
+            uint64_t end = cc.first[l] + cc.count[l];
+            limit[l] = (l < 64 && end < (1ULL << l)) ? end << (64 - l) : UINT64_MAX;
+        }
+    }
+
+    // window 为左对齐的后续比特，返回字符并给出码长。
+    // 码长表不完整时有些比特串不对应任何码字，此时返回 -1，len 置 0
+    int Decode(uint64_t window, int &len) const {
+        uint16_t e = fast[window >> (64 - DECODE_BITS)];
+        if (e != 0) {
+            len = e >> 8;
+            return e & 0xff;
+        }
+        int l = DECODE_BITS + 1;
+        while (l < cc.maxLen && window >= limit[l]) l++;
+        if (l > cc.maxLen || window >= limit[l]) {
+            len = 0;
+            return -1;
+        }
+        len = l;
+        uint64_t code = l < 64 ? window >> (64 - l) : window;
+        return cc.sorted[cc.offset[l] + (code - cc.first[l])];
+    }
+};
+
+// 解出 validBits 位的范式码流，每攒满一段输出就交给 sink(data, n)；返回输出字节数，出错返回 -1
+template <typename Sink>
+long long decode_canonical_bits(BitReader &reader, const CanonicalDecoder &dec, long long validBits, Sink sink) {
+    char outbuf[1 << 14];
+    size_t outpos = 0;
+    long long outBytes = 0;
+    long long remaining = validBits;
+    while (remaining > 0) {
+        // 补充后窗口至少有 57 位；int 频数下树高不会超过 46，码字总能一次看全
+        reader.Refill();
+        int len;
+        int c = dec.Decode(reader.acc, len);
+        if (c < 0 || len > remaining || len > reader.nbits) {
+            cerr << "corrupt stream at bit " << validBits - remaining << endl;
+            return -1;
+        }
+        reader.Skip(len);
+        remaining -= len;
+        outbuf[outpos++] = (char)c;
+        if (outpos == sizeof(outbuf)) {
+            sink(outbuf, outpos);
+            outBytes += outpos;
+            outpos = 0;
+        }
+    }
+    sink(outbuf, outpos);
+    return outBytes + outpos;
+}
+
+long long decompress_canonical(double &secs) {
+    ifstream fin(zip, ios::binary);
+    if (!fin.is_open()) {
+        cerr << "can not open " << zip << endl;
+        return -1;
+    }
+    char magic[4];
+    long long validBits = 0;
+    unsigned char header[256];
+    fin.read(magic, 4);
+    fin.read(reinterpret_cast<char*>(&validBits), sizeof(validBits));
+    fin.read(reinterpret_cast<char*>(header), sizeof(header));
+    CanonicalCode cc;
+    for (int c = 0; c < 256; c++) cc.lens[c] = header[c];
+    if (!fin || memcmp(magic, CANONICAL_MAGIC, 4) != 0 || !cc.Assign()) {
+        cerr << "bad canonical header in " << zip << endl;
+        return -1;
+    }
+
+    auto start = chrono::steady_clock::now();
+    CanonicalDecoder dec(cc);
+    BitReader reader(fin);
+    ofstream fout(txt, ios::binary);
+    long long outBytes = decode_canonical_bits(reader, dec, validBits, [&fout](const char *data, size_t n) {
+        fout.write(data, n);
+    });
+    fout.close();
+
+    secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return outBytes;
+}
+
+
+// 分块模式：输入切成 BLOCK_SIZE 的独立块，每块有自己的范式码表，可以并行编解码、按块随机访问。
+// 文件布局：魔数 "HFBK"、块大小、原文件字节数、块数，随后是块索引
+// （每块在文件中的偏移、原始长度、有效比特数），最后依次是各块的 256 字节码长和比特流
+#define BLOCK_MAGIC "HFBK"
+#define BLOCK_SIZE (1 << 20)
+// 块内码长上限，解码时大部分码字都能一次查表
+#define BLOCK_CODE_LIMIT 15
+
+struct BlockIndexEntry {
+    uint64_t offset;
+    uint32_t rawLen;
+    uint32_t reserved;
+    uint64_t validBits;
+};
+
+// 固定线程数的线程池，ParallelFor 把 [0, n) 的任务分给各线程并等待全部完成
+struct ThreadPool {
+    vector<thread> workers;
+    mutex mtx;
+    condition_variable cv, done_cv;
+    function<void(int)> job;
+    int total = 0;
+    int next = 0;
+    int finished = 0;
+    long long generation = 0;
+    bool stop = false;
+
+    ThreadPool(int n) {
+        for (int i = 0; i < n; i++) {
+            workers.emplace_back([this]() { Work(); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            lock_guard<mutex> lk(mtx);
+            stop = true;
+        }
+        cv.notify_all();
+        for (auto &w : workers) w.join();
+    }
+
+    void Work() {
+        long long seen = 0;
+        unique_lock<mutex> lk(mtx);
+        while (true) {
+            cv.wait(lk, [&]() { return stop || (generation != seen && next < total); });
+            if (stop) return;
+            while (next < total) {
+                int i = next++;
+                lk.unlock();
+                job(i);
+                lk.lock();
+                if (++finished == total) done_cv.notify_all();
+            }
+            seen = generation;
+        }
+    }
+
+    void ParallelFor(int n, function<void(int)> fn) {
+        if (n == 0) return;
+        unique_lock<mutex> lk(mtx);
+        job = fn;
+        total = n;
+        next = 0;
+        finished = 0;
+        generation++;
+        cv.notify_all();
+        done_cv.wait(lk, [&]() { return finished == total; });
+    }
+};
+
+int pool_threads(int argc, char* argv[]) {
+    int n = argc > 2 ? atoi(argv[2]) : (int)thread::hardware_concurrency();
+    return max(n, 1);
+}
+
+// 压缩一个块：统计频率、求限长码长、输出 256 字节码长和比特流
+void encode_block(const unsigned char *p, size_t n, string &out, uint64_t &validBits) {
+    uint64_t counts[256] = {0};
+    count_bytes(p, n, counts);
+
+    CanonicalCode cc;
+    if (!limited_code_lengths(counts, BLOCK_CODE_LIMIT, cc.lens) || !cc.Assign()) assert(false);
+
+    ostringstream os;
+    unsigned char header[256];
+    for (int c = 0; c < 256; c++) header[c] = cc.lens[c];
+    os.write(reinterpret_cast<const char*>(header), sizeof(header));
+    BitWriter writer(os);
+    for (size_t i = 0; i < n; i++) {
+        writer.Put(cc.codes[p[i]], cc.lens[p[i]]);
+    }
+    writer.Finish();
+    validBits = writer.bits;
+    out = os.str();
+}
+
+// 解压一个块，data 指向该块的码长头部
+bool decode_block(const string &data, const BlockIndexEntry &e, vector<char> &out) {
+    if (data.size() < 256) return false;
+    CanonicalCode cc;
+    for (int c = 0; c < 256; c++) cc.lens[c] = (unsigned char)data[c];
+    if (!cc.Assign()) return false;
+
+    CanonicalDecoder dec(cc);
+    istringstream is(data.substr(256));
+    BitReader reader(is);
+    out.clear();
+    out.reserve(e.rawLen);
+    long long n = decode_canonical_bits(reader, dec, e.validBits, [&out](const char *d, size_t k) {
+        out.insert(out.end(), d, d + k);
+    });
+    return n == e.rawLen;
+}
+
+void compress_blocks(int threads) {
+    ifstream fin(txt, ios::binary | ios::ate);
+    if (!fin.is_open()) {
+        cerr << "can not open " << txt << endl;
+        return;
+    }
+    uint64_t totalBytes = fin.tellg();
+    fin.seekg(0, ios::beg);
+    uint32_t nblocks = (totalBytes + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    uint32_t blockSize = BLOCK_SIZE;
+
+    ofstream fout(zip, ios::binary);
+    fout.write(BLOCK_MAGIC, 4);
+    fout.write(reinterpret_cast<const char*>(&blockSize), sizeof(blockSize));
+    fout.write(reinterpret_cast<const char*>(&totalBytes), sizeof(totalBytes));
+    fout.write(reinterpret_cast<const char*>(&nblocks), sizeof(nblocks));
+    vector<BlockIndexEntry> index(nblocks);
+    uint64_t indexPos = fout.tellp();
+    fout.write(reinterpret_cast<const char*>(index.data()), nblocks * sizeof(BlockIndexEntry));
+    uint64_t offset = fout.tellp();
+
+    // 每批读入 threads * 4 个块并行压缩，再按顺序写出，内存只与批大小有关
+    ThreadPool pool(threads);
+    int batch = threads * 4;
+    vector<vector<unsigned char>> raw(batch, vector<unsigned char>(BLOCK_SIZE));
+    vector<string> packed(batch);
+    for (uint32_t first = 0; first < nblocks; first += batch) {
+        int cnt = min<uint32_t>(batch, nblocks - first);
+        for (int k = 0; k < cnt; k++) {
+            fin.read(reinterpret_cast<char*>(raw[k].data()), BLOCK_SIZE);
+            index[first + k].rawLen = fin.gcount();
+        }
+        pool.ParallelFor(cnt, [&](int k) {
+            encode_block(raw[k].data(), index[first + k].rawLen, packed[k], index[first + k].validBits);
+        });
+        for (int k = 0; k < cnt; k++) {
+            index[first + k].offset = offset;
+            fout.write(packed[k].data(), packed[k].size());
+            offset += packed[k].size();
+        }
+    }
+
+    fout.seekp(indexPos, ios::beg);
+    fout.write(reinterpret_cast<const char*>(index.data()), nblocks * sizeof(BlockIndexEntry));
+    fout.close();
+
+    cout << nblocks << endl << offset << endl;
+}
+
+void decompress_blocks(int threads) {
+    ifstream fin(zip, ios::binary | ios::ate);
+    if (!fin.is_open()) {
+        cerr << "can not open " << zip << endl;
+        return;
+    }
+    uint64_t fileSize = fin.tellg();
+    fin.seekg(0, ios::beg);
+    char magic[4];
+    uint32_t blockSize = 0, nblocks = 0;
+    uint64_t totalBytes = 0;
+    fin.read(magic, 4);
+    fin.read(reinterpret_cast<char*>(&blockSize), sizeof(blockSize));
+    fin.read(reinterpret_cast<char*>(&totalBytes), sizeof(totalBytes));
+    fin.read(reinterpret_cast<char*>(&nblocks), sizeof(nblocks));
+    if (!fin || memcmp(magic, BLOCK_MAGIC, 4) != 0 || blockSize > BLOCK_SIZE) {
+        cerr << "bad block header in " << zip << endl;
+        return;
+    }
+    // 索引和各块的位置都来自文件，分配内存前先确认它们落在文件之内：
+    // 块数不超过剩余字节能放下的索引项，偏移从索引之后开始、不递减且不超过文件末尾
+    uint64_t indexStart = fin.tellg();
+    if (nblocks > (fileSize - indexStart) / sizeof(BlockIndexEntry)) {
+        cerr << "bad block index in " << zip << endl;
+        return;
+    }
+    vector<BlockIndexEntry> index(nblocks);
+    fin.read(reinterpret_cast<char*>(index.data()), nblocks * sizeof(BlockIndexEntry));
+    uint64_t prevOffset = indexStart + (uint64_t)nblocks * sizeof(BlockIndexEntry);
+    bool indexOk = (bool)fin;
+    for (uint32_t i = 0; indexOk && i < nblocks; i++) {
+        indexOk = index[i].offset >= prevOffset && index[i].offset <= fileSize && index[i].rawLen <= blockSize;
+        prevOffset = index[i].offset;
+    }
+    if (!indexOk) {
+        cerr << "bad block index in " << zip << endl;
+        return;
+    }
+
+    auto start = chrono::steady_clock::now();
+    ThreadPool pool(threads);
+    ofstream fout(txt, ios::binary);
+    int batch = threads * 4;
+    vector<string> packed(batch);
+    vector<vector<char>> raw(batch);
+    vector<int> ok(batch);
+    uint64_t outBytes = 0;
+    for (uint32_t first = 0; first < nblocks; first += batch) {
+        int cnt = min<uint32_t>(batch, nblocks - first);
+        for (int k = 0; k < cnt; k++) {
+            uint64_t end = first + k + 1 < nblocks ? index[first + k + 1].offset : fileSize;
+            packed[k].resize(end - index[first + k].offset);
+            fin.seekg(index[first + k].offset, ios::beg);
+            fin.read(&packed[k][0], packed[k].size());
+        }
+        pool.ParallelFor(cnt, [&](int k) {
+            ok[k] = decode_block(packed[k], index[first + k], raw[k]);
+        });
+        for (int k = 0; k < cnt; k++) {
+            if (!ok[k]) {
+                cerr << "corrupt block " << first + k << endl;
+                return;
+            }
+            fout.write(raw[k].data(), raw[k].size());
+            outBytes += raw[k].size();
+        }
+    }
+    fout.close();
+    if (outBytes != totalBytes) {
+        cerr << "expected " << totalBytes << " bytes, got " << outBytes << endl;
+    }
+
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << outBytes << endl;
+    cout << "decode " << (secs > 0 ? outBytes / secs / 1e6 : 0) << " MB/s" << endl;
+}
+
+// order-1 模式：按前一个字节选择码表，每个出现过的上下文各有一套范式码。
+// 文件头为魔数 "HFO1"、有效比特数、32 字节的上下文位图，随后每个用到的上下文
+// 用 128 字节存 256 个 4 位码长，最后是比特流。首字节的上下文视为 0
+#define ORDER1_MAGIC "HFO1"
+#define ORDER1_CODE_LIMIT 15
+
+long long compress_order1() {
+    ifstream fin(txt, ios::binary);
+    if (!fin.is_open()) {
+        cerr << "can not open " << txt << endl;
+        return -1;
+    }
+    vector<uint64_t> counts(256 * 256, 0);
+    vector<char> inbuf(1 << 16);
+    unsigned char prev = 0;
+    while (fin.read(inbuf.data(), inbuf.size()) || fin.gcount() > 0) {
+        streamsize n = fin.gcount();
+        for (streamsize i = 0; i < n; i++) {
+            unsigned char c = inbuf[i];
+            counts[prev * 256 + c]++;
+            prev = c;
         }
     }
     fin.close();
 
-    long long validBits = bitstream.length();
+    vector<CanonicalCode> ccs(256);
+    unsigned char bitmap[32] = {0};
+    for (int ctx = 0; ctx < 256; ctx++) {
+        if (!limited_code_lengths(&counts[ctx * 256], ORDER1_CODE_LIMIT, ccs[ctx].lens) || !ccs[ctx].Assign()) {
+            assert(false);
+        }
+        if (ccs[ctx].nsyms > 0) bitmap[ctx / 8] |= 1 << (ctx % 8);
+    }
 
-    ofstream fout(zip);
+    ofstream fout(zip, ios::binary);
+    long long validBits = 0;
+    fout.write(ORDER1_MAGIC, 4);
     fout.write(reinterpret_cast<const char*>(&validBits), sizeof(validBits));
+    fout.write(reinterpret_cast<const char*>(bitmap), sizeof(bitmap));
+    for (int ctx = 0; ctx < 256; ctx++) {
+        if (ccs[ctx].nsyms == 0) continue;
+        unsigned char packed[128];
+        for (int c = 0; c < 256; c += 2) {
+            packed[c / 2] = ccs[ctx].lens[c] << 4 | ccs[ctx].lens[c + 1];
+        }
+        fout.write(reinterpret_cast<const char*>(packed), sizeof(packed));
+    }
 
-    if (bitstream.length() % 8 != 0) {
-        int padding = 8 - (bitstream.length() % 8);
-        while (padding--) {
-            bitstream += '0';
+    fin.open(txt, ios::binary);
+    BitWriter writer(fout);
+    prev = 0;
+    while (fin.read(inbuf.data(), inbuf.size()) || fin.gcount() > 0) {
+        streamsize n = fin.gcount();
+        for (streamsize i = 0; i < n; i++) {
+            unsigned char c = inbuf[i];
+            writer.Put(ccs[prev].codes[c], ccs[prev].lens[c]);
+            prev = c;
         }
     }
+    writer.Finish();
 
-    for (int i = 0; i < bitstream.length(); i += 8) {
-        string byte = bitstream.substr(i, 8);
-        unsigned char byteValue = 0;
+    validBits = writer.bits;
+    fout.seekp(4, ios::beg);
+    fout.write(reinterpret_cast<const char*>(&validBits), sizeof(validBits));
+    fout.close();
+    return validBits;
+}
+
+long long decompress_order1(double &secs) {
+    ifstream fin(zip, ios::binary);
+    if (!fin.is_open()) {
+        cerr << "can not open " << zip << endl;
+        return -1;
+    }
+    char magic[4];
+    long long validBits = 0;
+    unsigned char bitmap[32];
+    fin.read(magic, 4);
+    fin.read(reinterpret_cast<char*>(&validBits), sizeof(validBits));
+    fin.read(reinterpret_cast<char*>(bitmap), sizeof(bitmap));
+    if (!fin || memcmp(magic, ORDER1_MAGIC, 4) != 0) {
+        cerr << "bad order-1 header in " << zip << endl;
+        return -1;
+    }
 
-        for (int j = 0; j < 8; j++) {
-            if (byte[j] == '1') {
-                byteValue |= (1 << (7 - j));
+    auto start = chrono::steady_clock::now();
+    vector<CanonicalCode> ccs(256);
+    vector<unique_ptr<CanonicalDecoder>> decs(256);
+    for (int ctx = 0; ctx < 256; ctx++) {
+        memset(ccs[ctx].lens, 0, sizeof(ccs[ctx].lens));
+        if (bitmap[ctx / 8] >> (ctx % 8) & 1) {
+            unsigned char packed[128];
+            fin.read(reinterpret_cast<char*>(packed), sizeof(packed));
+            for (int c = 0; c < 256; c += 2) {
+                ccs[ctx].lens[c] = packed[c / 2] >> 4;
+                ccs[ctx].lens[c + 1] = packed[c / 2] & 0xf;
             }
         }
+        if (!fin || !ccs[ctx].Assign()) {
+            cerr << "bad order-1 table for context " << ctx << endl;
+            return -1;
+        }
+        if (ccs[ctx].nsyms > 0) decs[ctx].reset(new CanonicalDecoder(ccs[ctx]));
+    }
 
-        fout.write(reinterpret_cast<const char*>(&byteValue), 1);
+    BitReader reader(fin);
+    ofstream fout(txt, ios::binary);
+    vector<char> outbuf(1 << 16);
+    size_t outpos = 0;
+    long long outBytes = 0;
+    long long remaining = validBits;
+    unsigned char prev = 0;
+    while (remaining > 0) {
+        reader.Refill();
+        int len = 0;
+        int c = decs[prev] ? decs[prev]->Decode(reader.acc, len) : -1;
+        if (c < 0 || len > remaining || len > reader.nbits) {
+            cerr << "corrupt stream at bit " << validBits - remaining << endl;
+            return -1;
+        }
+        reader.Skip(len);
+        remaining -= len;
+        outbuf[outpos++] = (char)c;
+        if (outpos == outbuf.size()) {
+            fout.write(outbuf.data(), outpos);
+            outBytes += outpos;
+            outpos = 0;
+        }
+        prev = c;
     }
+    fout.write(outbuf.data(), outpos);
+    outBytes += outpos;
+    fout.close();
+
+    secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return outBytes;
+}
+
+// 四路交错模式（参考 Huff0）：输入按 X4_BLOCK 分块，每块码长限制在 DECODE_BITS 以内，
+// 块内再平均切成 4 段各自编码成独立比特流，解码时 4 条流在同一线程里交替推进，
+// 互不依赖的查表可以重叠执行。查找表一项最多给出 X4_MAX_SYMS 个字符。
+// 文件布局：魔数 "HFX4"、原文件字节数，随后每块为原始长度、128 字节 4 位码长、
+// 4 条流的字节数和 4 条流本身
+#define X4_MAGIC "HFX4"
+#define X4_BLOCK (1 << 20)
+#define X4_MAX_SYMS 3
+
+struct MultiEntry {
+    uint8_t syms[4];  // 只有前 nsym 个有效，整体按 4 字节写出
+    uint8_t nsym;     // 0 表示无效前缀
+    uint8_t bits;     // 全部字符的码长之和
+    uint8_t len1;     // 第一个字符的码长，尾部逐个解码时使用
+};
+
+struct MultiDecodeTable {
+    MultiEntry entries[1 << DECODE_BITS];
+
+    // 每个下标先解出第一个字符，剩余比特若还能完整容纳下一个码字就继续
+    void Init(const CanonicalDecoder &dec, int maxSyms) {
+        const uint32_t mask = (1u << DECODE_BITS) - 1;
+        for (uint32_t i = 0; i <= mask; i++) {
+            MultiEntry e;
+            memset(&e, 0, sizeof(e));
+            uint32_t window = i;
+            int used = 0;
+            while (e.nsym < maxSyms) {
+                uint16_t f = dec.fast[window & mask];
+                int len = f >> 8;
+                if (len == 0 || used + len > DECODE_BITS) break;
+                e.syms[e.nsym++] = f & 0xff;
+                if (e.nsym == 1) e.len1 = len;
+                used += len;
+                window = (window << len) & mask;
+            }
+            e.bits = used;
+            entries[i] = e;
+        }
+    }
+};
+
+static inline uint64_t load_be64(const unsigned char *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return __builtin_bswap64(v);
+}
+
+// 四段的边界：前三段长度相同，最后一段取剩余部分
+static inline void x4_segments(uint32_t rawLen, uint32_t begin[4], uint32_t end[4]) {
+    uint32_t seg = (rawLen + 3) / 4;
+    for (int k = 0; k < 4; k++) {
+        begin[k] = min(rawLen, k * seg);
+        end[k] = min(rawLen, (k + 1) * seg);
+    }
+}
+
+void encode_x4_block(const unsigned char *p, uint32_t n, string &out) {
+    uint64_t counts[256] = {0};
+    count_bytes(p, n, counts);
+    CanonicalCode cc;
+    if (!limited_code_lengths(counts, DECODE_BITS, cc.lens) || !cc.Assign()) assert(false);
 
+    string streams[4];
+    uint32_t begin[4], end[4], sizes[4];
+    x4_segments(n, begin, end);
+    for (int k = 0; k < 4; k++) {
+        ostringstream os;
+        BitWriter writer(os);
+        for (uint32_t i = begin[k]; i < end[k]; i++) {
+            writer.Put(cc.codes[p[i]], cc.lens[p[i]]);
+        }
+        writer.Finish();
+        streams[k] = os.str();
+        sizes[k] = streams[k].size();
+    }
+
+    unsigned char packed[128];
+    for (int c = 0; c < 256; c += 2) packed[c / 2] = cc.lens[c] << 4 | cc.lens[c + 1];
+    out.assign(reinterpret_cast<const char*>(&n), sizeof(n));
+    out.append(reinterpret_cast<const char*>(packed), sizeof(packed));
+    out.append(reinterpret_cast<const char*>(sizes), sizeof(sizes));
+    for (int k = 0; k < 4; k++) out += streams[k];
+}
+
+// data 为 4 条流首尾相接的字节，末尾至少留 8 字节可读的填充
+bool decode_x4_block(const MultiDecodeTable &table, const unsigned char *data, const uint32_t sizes[4],
+                     uint32_t rawLen, unsigned char *out) {
+    const unsigned char *base[4];
+    uint64_t pos[4] = {0, 0, 0, 0};
+    uint64_t limitBits[4];
+    uint32_t begin[4], end[4];
+    x4_segments(rawLen, begin, end);
+    unsigned char *op[4];
+    for (int k = 0, off = 0; k < 4; off += sizes[k], k++) {
+        base[k] = data + off;
+        limitBits[k] = (uint64_t)sizes[k] * 8;
+        op[k] = out + begin[k];
+    }
+
+    // 每条流还剩至少 4 个字符时，4 条流轮流各查一次表；4 字节整体写出不会越过本段
+#define X4_STEP(k) { \
+        uint64_t w = load_be64(base[k] + (pos[k] >> 3)) << (pos[k] & 7); \
+        const MultiEntry &e = table.entries[w >> (64 - DECODE_BITS)]; \
+        memcpy(op[k], e.syms, 4); \
+        op[k] += e.nsym; \
+        pos[k] += e.bits; \
+        ok &= e.nsym != 0; \
+    }
+    bool ok = true;
+    while (ok && op[0] + 4 <= out + end[0] && op[1] + 4 <= out + end[1] &&
+           op[2] + 4 <= out + end[2] && op[3] + 4 <= out + end[3]) {
+        X4_STEP(0);
+        X4_STEP(1);
+        X4_STEP(2);
+        X4_STEP(3);
+        // 每轮每条流只前进一步，轮末都没读过界，下一轮的读取就落在本流或末尾的填充内
+        ok &= pos[0] <= limitBits[0] && pos[1] <= limitBits[1] && pos[2] <= limitBits[2] && pos[3] <= limitBits[3];
+    }
+#undef X4_STEP
+    if (!ok) return false;
+
+    // 各流剩下的字符逐个解码
+    for (int k = 0; k < 4; k++) {
+        while (op[k] < out + end[k]) {
+            if (pos[k] > limitBits[k]) return false;
+            uint64_t w = load_be64(base[k] + (pos[k] >> 3)) << (pos[k] & 7);
+            const MultiEntry &e = table.entries[w >> (64 - DECODE_BITS)];
+            if (e.nsym == 0) return false;
+            *op[k]++ = e.syms[0];
+            pos[k] += e.len1;
+        }
+        if (pos[k] > limitBits[k]) return false;
+    }
+    return true;
+}
+
+void compress_x4() {
+    ifstream fin(txt, ios::binary | ios::ate);
+    if (!fin.is_open()) {
+        cerr << "can not open " << txt << endl;
+        return;
+    }
+    uint64_t totalBytes = fin.tellg();
+    fin.seekg(0, ios::beg);
+
+    ofstream fout(zip, ios::binary);
+    fout.write(X4_MAGIC, 4);
+    fout.write(reinterpret_cast<const char*>(&totalBytes), sizeof(totalBytes));
+    vector<unsigned char> raw(X4_BLOCK);
+    string packed;
+    uint64_t outBytes = 4 + sizeof(totalBytes);
+    while (fin.read(reinterpret_cast<char*>(raw.data()), raw.size()) || fin.gcount() > 0) {
+        encode_x4_block(raw.data(), fin.gcount(), packed);
+        fout.write(packed.data(), packed.size());
+        outBytes += packed.size();
+    }
     fout.close();
+    cout << outBytes << endl;
+}
 
-    cout << validBits << endl;
+void decompress_x4(int maxSyms) {
+    ifstream fin(zip, ios::binary);
+    if (!fin.is_open()) {
+        cerr << "can not open " << zip << endl;
+        return;
+    }
+    char magic[4];
+    uint64_t totalBytes = 0;
+    fin.read(magic, 4);
+    fin.read(reinterpret_cast<char*>(&totalBytes), sizeof(totalBytes));
+    if (!fin || memcmp(magic, X4_MAGIC, 4) != 0) {
+        cerr << "bad x4 header in " << zip << endl;
+        return;
+    }
+
+    ofstream fout(txt, ios::binary);
+    vector<unsigned char> data, out(X4_BLOCK);
+    unique_ptr<MultiDecodeTable> table(new MultiDecodeTable());
+    uint64_t outBytes = 0;
+    double secs = 0;
+    while (outBytes < totalBytes) {
+        uint32_t rawLen = 0, sizes[4];
+        unsigned char packed[128];
+        fin.read(reinterpret_cast<char*>(&rawLen), sizeof(rawLen));
+        fin.read(reinterpret_cast<char*>(packed), sizeof(packed));
+        fin.read(reinterpret_cast<char*>(sizes), sizeof(sizes));
+        uint64_t streamBytes = (uint64_t)sizes[0] + sizes[1] + sizes[2] + sizes[3];
+        if (!fin || rawLen > X4_BLOCK || streamBytes > 2 * (uint64_t)X4_BLOCK) {
+            cerr << "bad x4 block header" << endl;
+            return;
+        }
+        data.assign(streamBytes + 8, 0);
+        fin.read(reinterpret_cast<char*>(data.data()), streamBytes);
+
+        auto start = chrono::steady_clock::now();
+        CanonicalCode cc;
+        for (int c = 0; c < 256; c += 2) {
+            cc.lens[c] = packed[c / 2] >> 4;
+            cc.lens[c + 1] = packed[c / 2] & 0xf;
+        }
+        if (!fin || !cc.Assign() || cc.maxLen > DECODE_BITS) {
+            cerr << "bad x4 code table" << endl;
+            return;
+        }
+        // 每个字符至少占最短码长，流的字节数装不下本段字符时头部必然有误
+        int minLen = cc.maxLen;
+        for (int c = 0; c < 256; c++) {
+            if (cc.lens[c] > 0) minLen = min(minLen, cc.lens[c]);
+        }
+        uint32_t begin[4], end[4];
+        x4_segments(rawLen, begin, end);
+        for (int k = 0; k < 4; k++) {
+            if ((uint64_t)sizes[k] * 8 < (uint64_t)(end[k] - begin[k]) * minLen ||
+                (cc.nsyms == 0 && end[k] > begin[k])) {
+                cerr << "bad x4 block header" << endl;
+                return;
+            }
+        }
+        CanonicalDecoder dec(cc);
+        table->Init(dec, maxSyms);
+        if (!decode_x4_block(*table, data.data(), sizes, rawLen, out.data())) {
+            cerr << "corrupt x4 block at byte " << outBytes << endl;
+            return;
+        }
+        secs += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        fout.write(reinterpret_cast<const char*>(out.data()), rawLen);
+        outBytes += rawLen;
+    }
+    fout.close();
+
+    cout << outBytes << endl;
+    cout << "decode " << (secs > 0 ? outBytes / secs / 1e6 : 0) << " MB/s" << endl;
 }
 
-int main() {
+// 对同一个输入比较 order-0 范式码与 order-1 模式的压缩率和速度，
+// zip 作为临时压缩文件，还原结果写到 zip + ".out"
+void bench_modes() {
+    string input = txt, packed = zip, restored = zip + ".out";
+    if (!histogram.CountFile(input)) {
+        cerr << "can not open " << input << endl;
+        return;
+    }
+    cout << "mode ratio encode(MB/s) decode(MB/s)" << endl;
+    for (int m = 0; m < 2; m++) {
+        txt = input;
+        zip = packed;
+        auto start = chrono::steady_clock::now();
+        if (m == 0) {
+            CanonicalCode cc;
+            if (!limited_code_lengths(histogram.counts, CANONICAL_MAX_LEN, cc.lens) || !cc.Assign()) assert(false);
+            compress_canonical(cc);
+        } else {
+            compress_order1();
+        }
+        double encSecs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        ifstream zf(packed, ios::binary | ios::ate);
+        double zipBytes = zf.tellg();
+        zf.close();
+
+        txt = restored;
+        double decSecs = 0;
+        long long outBytes = m == 0 ? decompress_canonical(decSecs) : decompress_order1(decSecs);
+        if (outBytes != (long long)histogram.total) {
+            cerr << "round trip failed" << endl;
+        }
+        double mb = histogram.total / 1e6;
+        cout << (m == 0 ? "order0" : "order1") << " " << (histogram.total ? zipBytes / histogram.total : 0)
+             << " " << (encSecs > 0 ? mb / encSecs : 0) << " " << (decSecs > 0 ? mb / decSecs : 0) << endl;
+    }
+    txt = input;
+    zip = packed;
+}
+
+int main(int argc, char* argv[]) {
+    string mode = argc > 1 ? argv[1] : "compress";
+    if (mode == "decompress") {
+        // 输入 zip 与 idx，还原到 txt
+        cin >> txt >> idx >> zip;
+        decompress();
+        return 0;
+    }
+    if (mode == "canonical") {
+        // 范式哈夫曼只需要 txt 和 zip；可选的第二个参数限制最大码长
+        cin >> txt >> zip;
+        do_statistics();
+        CanonicalCode cc;
+        memset(cc.lens, 0, sizeof(cc.lens));
+        // 空输入没有字符可建树，码长全为 0，只写文件头
+        if (histogram.Distinct() > 0) {
+            build_tree();
+            if (argc > 2) {
+                int limit = atoi(argv[2]);
+                if (!limited_code_lengths(histogram.counts, limit, cc.lens)) {
+                    cerr << "can not limit " << histogram.Distinct() << " symbols to " << limit << " bits" << endl;
+                    return 1;
+                }
+            } else {
+                tree_code_lengths(huffmanTree, 0, cc.lens);
+            }
+        }
+        if (!cc.Assign()) assert(false);
+        if (argc > 2) cout << cc.maxLen << endl;
+        long long validBits = compress_canonical(cc);
+        if (validBits < 0) {
+            assert(false);
+        }
+        cout << validBits << endl;
+        return 0;
+    }
+    if (mode == "stats") {
+        // 只做字节统计并报告速度
+        cin >> txt;
+        do_statistics();
+        cout << "count " << (histogram.seconds > 0 ? histogram.total / histogram.seconds / 1e9 : 0) << " GB/s" << endl;
+        return 0;
+    }
+    if (mode == "block") {
+        // 分块并行压缩，可选第二个参数为线程数
+        cin >> txt >> zip;
+        compress_blocks(pool_threads(argc, argv));
+        return 0;
+    }
+    if (mode == "block-decompress") {
+        cin >> txt >> zip;
+        decompress_blocks(pool_threads(argc, argv));
+        return 0;
+    }
+    if (mode == "canonical-decompress" || mode == "order1-decompress") {
+        cin >> txt >> zip;
+        double secs = 0;
+        long long outBytes = mode == "order1-decompress" ? decompress_order1(secs) : decompress_canonical(secs);
+        if (outBytes < 0) return 1;
+        cout << outBytes << endl;
+        cout << "decode " << (secs > 0 ? outBytes / secs / 1e6 : 0) << " MB/s" << endl;
+        return 0;
+    }
+    if (mode == "order1") {
+        // 按前一个字节选码表，适合上下文相关性强的文本
+        cin >> txt >> zip;
+        long long validBits = compress_order1();
+        if (validBits < 0) return 1;
+        cout << validBits << endl;
+        return 0;
+    }
+    if (mode == "x4") {
+        // 四路交错流 + 多字符查找表
+        cin >> txt >> zip;
+        compress_x4();
+        return 0;
+    }
+    if (mode == "x4-decompress") {
+        // 可选第二个参数为每次查表最多输出的字符数，1 即普通单字符表
+        cin >> txt >> zip;
+        int maxSyms = argc > 2 ? atoi(argv[2]) : X4_MAX_SYMS;
+        decompress_x4(max(1, min(maxSyms, X4_MAX_SYMS)));
+        return 0;
+    }
+    if (mode == "bench") {
+        cin >> txt >> zip;
+        bench_modes();
+        return 0;
+    }
     cin >> txt >> idx >> zip;
+
     // 2.1
     do_statistics();
 
@@ -10,19 +10,20 @@
 #include <string>
 #include <algorithm>
 #include <cstring>
+#include <cstdint>
 
 using namespace std;
 
 // 哈夫曼树节点结构
 struct HuffmanNode {
     char ch;           // 字符
-    int freq;          // 频率
+    long long freq;    // 频率
     int minAscii;      // 子树中最小ASCII码
     HuffmanNode* left;
     HuffmanNode* right;
     
-    HuffmanNode(char c, int f) : ch(c), freq(f), minAscii(c), left(nullptr), right(nullptr) {}
-    HuffmanNode(int f, int minAsc) : ch(0), freq(f), minAscii(minAsc), left(nullptr), right(nullptr) {}
+    HuffmanNode(char c, long long f) : ch(c), freq(f), minAscii(c), left(nullptr), right(nullptr) {}
+    HuffmanNode(long long f, int minAsc) : ch(0), freq(f), minAscii(minAsc), left(nullptr), right(nullptr) {}
 };
 
 // 用于优先队列的比较器
@@ -36,7 +37,7 @@ struct Compare {
 };
 
 // 全局变量
-map<char, int> freqTable;           // 字符频率表
+map<char, long long> freqTable;     // 字符频率表
 HuffmanNode* huffmanTree = nullptr;  // 哈夫曼树根节点
 map<char, string> codingTable;      // 字符编码表
 
@@ -48,24 +49,32 @@ void do_statistics(const string& filename) {
         return;
     }
     
+    // 通过固定大小的缓冲区计数，内存占用与文件大小无关
     freqTable.clear();
-    char ch;
-    while (file.get(ch)) {
-        freqTable[ch]++;
+    long long counts[256] = {0};
+    vector<char> buf(1 << 16);
+    while (file.read(buf.data(), buf.size()) || file.gcount() > 0) {
+        streamsize n = file.gcount();
+        for (streamsize i = 0; i < n; i++) {
+            counts[(unsigned char)buf[i]]++;
+        }
     }
     file.close();
+    for (int c = 0; c < 256; c++) {
+        if (counts[c]) freqTable[(char)c] = counts[c];
+    }
     
     // 输出统计结果
     cout << freqTable.size() << endl;
     
     // 按频率排序找出前三个
-    vector<pair<int, char>> freqList;
+    vector<pair<long long, char>> freqList;
     for (auto& p : freqTable) {
         freqList.push_back({p.second, p.first});
     }
     
     // 按频率降序，ASCII码升序排序
-    sort(freqList.begin(), freqList.end(), [](const pair<int, char>& a, const pair<int, char>& b) {
+    sort(freqList.begin(), freqList.end(), [](const pair<long long, char>& a, const pair<long long, char>& b) {
         if (a.first != b.first) return a.first > b.first;
         return a.second < b.second;
     });
@@ -114,7 +123,7 @@ void build_tree() {
         }
         
         // 创建新的内部节点
-        int newFreq = left->freq + right->freq;
+        long long newFreq = left->freq + right->freq;
         int newMinAscii = min(left->minAscii, right->minAscii);
         HuffmanNode* newNode = new HuffmanNode(newFreq, newMinAscii);
         newNode->left = left;
@@ -165,6 +174,57 @@ void encode(const string& outputFile) {
     }
 }
 
+// 比特输出器：码字先拼进 64 位累加器（高位在前），满 64 位后按大端写入缓冲区
+struct BitWriter {
+    ofstream& out;
+    vector<unsigned char> buffer;
+    size_t pos;
+    uint64_t acc;       // 待输出的比特，从最高位开始填
+    int accBits;        // acc 中已填的比特数
+    long long totalBits;
+    
+    BitWriter(ofstream& o) : out(o), buffer(1 << 16), pos(0), acc(0), accBits(0), totalBits(0) {}
+    
+    void put(uint64_t code, int len) {
+        if (len == 0) return;
+        totalBits += len;
+        int room = 64 - accBits;
+        if (len < room) {
+            acc |= code << (room - len);
+            accBits += len;
+            return;
+        }
+        acc |= code >> (len - room);
+        putWord(acc);
+        len -= room;
+        acc = len ? code << (64 - len) : 0;
+        accBits = len;
+    }
+    
+    void putWord(uint64_t w) {
+        if (pos + 8 > buffer.size()) flush();
+        for (int i = 0; i < 8; i++) {
+            buffer[pos++] = (unsigned char)(w >> (56 - 8 * i));
+        }
+    }
+    
+    void flush() {
+        out.write(reinterpret_cast<const char*>(buffer.data()), pos);
+        pos = 0;
+    }
+    
+    // 输出剩余比特，最后一个字节低位补0
+    void finish() {
+        if (pos + 8 > buffer.size()) flush();
+        for (int i = 0; i < accBits; i += 8) {
+            buffer[pos++] = (unsigned char)(acc >> (56 - i));
+        }
+        acc = 0;
+        accBits = 0;
+        flush();
+    }
+};
+
 // 步骤四：压缩文件
 void compress(const string& inputFile, const string& outputFile) {
     ifstream inFile(inputFile, ios::binary);
@@ -173,43 +233,42 @@ void compress(const string& inputFile, const string& outputFile) {
         return;
     }
     
-    // 读取原文件并转换为比特流
-    string bitStream = "";
-    char ch;
-    while (inFile.get(ch)) {
-        bitStream += codingTable[ch];
-    }
-    inFile.close();
-    
-    // 计算有效比特数
-    long long validBits = bitStream.length();
-    
-    // 补足到8的倍数
-    while (bitStream.length() % 8 != 0) {
-        bitStream += "0";
-    }
-    
-    // 写入压缩文件
     ofstream outFile(outputFile, ios::binary);
     if (!outFile) {
         cerr << "无法创建输出文件: " << outputFile << endl;
         return;
     }
     
-    // 写入有效比特数（小端模式）
+    // 把编码表展开成数组，避免每个字符查一次map
+    uint64_t codes[256] = {0};
+    int lens[256] = {0};
+    for (auto& p : codingTable) {
+        unsigned char c = p.first;
+        lens[c] = p.second.length();
+        for (char b : p.second) {
+            codes[c] = (codes[c] << 1) | (b == '1');
+        }
+    }
+    
+    // 先写占位的有效比特数（小端模式），压缩完成后回填
+    long long validBits = 0;
     outFile.write(reinterpret_cast<const char*>(&validBits), sizeof(validBits));
     
-    // 将比特流转换为字节流并写入
-    for (size_t i = 0; i < bitStream.length(); i += 8) {
-        string byte = bitStream.substr(i, 8);
-        unsigned char byteValue = 0;
-        for (int j = 0; j < 8; j++) {
-            if (byte[j] == '1') {
-                byteValue |= (1 << (7 - j));  // 大端顺序
-            }
+    BitWriter writer(outFile);
+    vector<char> inBuf(1 << 16);
+    while (inFile.read(inBuf.data(), inBuf.size()) || inFile.gcount() > 0) {
+        streamsize n = inFile.gcount();
+        for (streamsize i = 0; i < n; i++) {
+            unsigned char c = inBuf[i];
+            writer.put(codes[c], lens[c]);
         }
-        outFile.write(reinterpret_cast<const char*>(&byteValue), 1);
     }
+    inFile.close();
+    writer.finish();
+    
+    validBits = writer.totalBits;
+    outFile.seekp(0, ios::beg);
+    outFile.write(reinterpret_cast<const char*>(&validBits), sizeof(validBits));
     outFile.close();
     
     cout << validBits << endl;
@@ -0,0 +1,150 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cstdlib>
+#include "dna.h"
+
+/* 性能测试：用人工生成的带簇数据分别测 LevDist、RangeQuery、DBSCAN、MinEPS 在不同规模下的耗时。
+ * 用法：dna_bench [最大 n] [序列长度] [突变率] [簇数] [eps] [minpts] [距离矩阵内存上限 MiB]
+ * n 从 1000 起每次乘 10，直到最大 n（默认 1000000）。距离矩阵超过内存上限的规模只测前两项 */
+
+struct BenchConfig{
+    uint32_t max_n = 1000000;
+    uint32_t length = 100;
+    double mutation_rate = 0.03;
+    uint32_t cluster_num = 100;
+    uint32_t eps = 5;
+    uint32_t minpts = 5;
+    uint64_t matrix_budget_mib = 2048;
+};
+
+/* 先随机生成 cluster_num 条中心序列，每条样本从某个中心复制而来，每个碱基以 mutation_rate 的概率
+ * 等可能地替换、删除或在其前插入一个碱基。另有约 5% 的样本是完全随机的序列，充当离群点 */
+void GenerateStrands(const BenchConfig &config, uint32_t n, uint64_t seed, PackedDnaStore &dna_set){
+    const char bases[] = "ACGT";
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> unit(0, 1);
+    auto random_strand = [&](){
+        std::string strand(config.length, 'A');
+        for(auto &c : strand)
+            c = bases[rng() & 3];
+        return strand;
+    };
+    std::vector<std::string> centers(config.cluster_num);
+    for(auto &center : centers)
+        center = random_strand();
+
+    dna_set.Reserve((uint64_t)n * (config.length + config.length / 10));
+    std::string strand;
+    for(uint32_t i = 0; i < n; i++){
+        if(unit(rng) < 0.05){
+            strand = random_strand();
+        }else{
+            const std::string &center = centers[rng() % centers.size()];
+            strand.clear();
+            for(char c : center){
+                if(unit(rng) >= config.mutation_rate){
+                    strand.push_back(c);
+                    continue;
+                }
+                switch(rng() % 3){
+                    case 0: strand.push_back(bases[rng() & 3]); break;
+                    case 1: break;
+                    default: strand.push_back(bases[rng() & 3]); strand.push_back(c); break;
+                }
+            }
+        }
+        dna_set.Append(strand.data(), strand.size());
+    }
+}
+
+double SecondsSince(std::chrono::steady_clock::time_point start){
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Report(uint32_t n, const char *stage, double seconds, double distances){
+    std::cout << std::setw(9) << n << "  " << std::setw(12) << std::left << stage << std::right
+              << std::setw(12) << std::fixed << std::setprecision(4) << seconds
+              << std::setw(16) << std::scientific << std::setprecision(3);
+    if(distances > 0)
+        std::cout << distances / seconds;
+    else
+        std::cout << "-";
+    std::cout << std::endl;
+}
+
+int main(int argc, char **argv){
+    BenchConfig config;
+    if(argc > 1) config.max_n = std::strtoul(argv[1], nullptr, 10);
+    if(argc > 2) config.length = std::strtoul(argv[2], nullptr, 10);
+    if(argc > 3) config.mutation_rate = std::strtod(argv[3], nullptr);
+    if(argc > 4) config.cluster_num = std::max(1ul, std::strtoul(argv[4], nullptr, 10));
+    if(argc > 5) config.eps = std::strtoul(argv[5], nullptr, 10);
+    if(argc > 6) config.minpts = std::strtoul(argv[6], nullptr, 10);
+    if(argc > 7) config.matrix_budget_mib = std::strtoull(argv[7], nullptr, 10);
+    uint32_t thread_num = std::max(1u, std::thread::hardware_concurrency());
+
+    std::cout << "length " << config.length << ", mutation rate " << config.mutation_rate
+              << ", clusters " << config.cluster_num << ", eps " << config.eps << ", minpts " << config.minpts
+              << ", threads " << thread_num << std::endl;
+    std::cout << std::setw(9) << "n" << "  " << std::setw(12) << std::left << "stage" << std::right
+              << std::setw(12) << "seconds" << std::setw(16) << "distances/s" << std::endl;
+
+    uint64_t checksum = 0;
+    for(uint64_t size = 1000; size <= config.max_n; size *= 10){
+        uint32_t n = size;
+        PackedDnaStore dna_set;
+        auto start = std::chrono::steady_clock::now();
+        GenerateStrands(config, n, n, dna_set);
+        Report(n, "generate", SecondsSince(start), 0);
+
+        /* LevDist：相邻两条序列之间的距离，最多 100000 对 */
+        uint32_t pair_num = std::min(n - 1, 100000u);
+        start = std::chrono::steady_clock::now();
+        for(uint32_t i = 0; i < pair_num; i++)
+            checksum += LevDist(dna_set[i], dna_set[i + 1]);
+        Report(n, "LevDist", SecondsSince(start), pair_num);
+
+        /* RangeQuery：以前 10 条序列为中心各查一次，每次都要和全部 n 条比较 */
+        uint32_t query_num = std::min(n, 10u);
+        start = std::chrono::steady_clock::now();
+        for(uint32_t i = 0; i < query_num; i++)
+            checksum += RangeQuery(dna_set, dna_set[i], config.eps).size();
+        Report(n, "RangeQuery", SecondsSince(start), (double)query_num * n);
+
+        /* DBSCAN 和 MinEPS 依赖完整的距离矩阵，n(n-1)/2 项，序列长度超过 255 时每项 2 字节，超过上限就跳过 */
+        uint32_t max_length = 0;
+        for(uint32_t i = 0; i < n; i++)
+            max_length = std::max(max_length, dna_set[i].size());
+        double pair_total = (double)n * (n - 1) / 2;
+        double matrix_mib = pair_total * (max_length > UINT8_MAX ? 2 : 1) / 1024 / 1024;
+        if(matrix_mib > config.matrix_budget_mib){
+            std::cout << std::setw(9) << n << "  skipped DBSCAN/MinEPS: distance matrix needs "
+                      << std::fixed << std::setprecision(0) << matrix_mib << " MiB" << std::endl;
+            continue;
+        }
+        TriDistMatrix dist_vec;
+        start = std::chrono::steady_clock::now();
+        dist_vec.Compute(dna_set, thread_num);
+        Report(n, "matrix", SecondsSince(start), pair_total);
+
+        uint32_t num_cores = 0, num_borders = 0, num_outliers = 0, num_clusters = 0;
+        std::vector<uint32_t> point_class(n, OUTLIER_POINT);
+        start = std::chrono::steady_clock::now();
+        DBSCAN(dna_set, config.eps, config.minpts, num_cores, num_borders, num_outliers, num_clusters,
+               point_class, dist_vec);
+        Report(n, "DBSCAN", SecondsSince(start), 0);
+
+        start = std::chrono::steady_clock::now();
+        checksum += MinEPS(dna_set, config.minpts, config.eps, point_class, dist_vec);
+        Report(n, "MinEPS", SecondsSince(start), 0);
+
+        std::cout << std::setw(9) << n << "  " << num_cores << " cores, " << num_borders << " borders, "
+                  << num_outliers << " outliers, " << num_clusters << " clusters" << std::endl;
+    }
+    /* 防止编译器把结果没用到的计算整个优化掉 */
+    std::cerr << "checksum " << checksum << std::endl;
+}
@@ -0,0 +1,731 @@
+#ifndef DNA_H
+#define DNA_H
+
+#include <iostream>
+#include <vector>
+#include <stack>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <thread>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#define CORE_POINT 1
+#define BORDER_POINT 2
+#define OUTLIER_POINT 3
+
+/* 2 位编码的一条序列，只是指向 PackedDnaStore 的视图。A C G T 依次编码为 0 1 2 3，
+ * 全局第 pos 个碱基在 words[pos / 32] 的第 2 * (pos % 32) 位起 */
+struct PackedSeq{
+    const uint64_t *words;
+    uint64_t first;
+    uint32_t length;
+
+    uint32_t size() const { return length; }
+
+    uint8_t operator[](uint32_t k) const {
+        uint64_t pos = first + k;
+        return (words[pos >> 5] >> ((pos & 31) * 2)) & 3;
+    }
+
+    /* 从第 k 个碱基起取 32 个碱基拼成一个字，超出序列的部分为 0。
+     * 起点不必对齐，比较时可以一次处理 32 个碱基 */
+    uint64_t Word(uint32_t k) const {
+        uint64_t pos = first + k;
+        uint32_t shift = (pos & 31) * 2;
+        uint64_t word = words[pos >> 5] >> shift;
+        if(shift != 0)
+            word |= words[(pos >> 5) + 1] << (64 - shift);
+        if(length - k < 32)
+            word &= (1ULL << (2 * (length - k))) - 1;
+        return word;
+    }
+};
+
+/* 两条序列在公共长度内的错配碱基数：按字异或，把每 2 位折成 1 位后计数。
+ * 等长时这是汉明距离，也是编辑距离的上界 */
+inline uint32_t Mismatches(const PackedSeq &a, const PackedSeq &b){
+    uint32_t length = std::min(a.size(), b.size());
+    uint32_t count = 0;
+    for(uint32_t k = 0; k < length; k += 32){
+        uint64_t diff = a.Word(k) ^ b.Word(k);
+        if(length - k < 32)
+            diff &= (1ULL << (2 * (length - k))) - 1;
+        diff = (diff | (diff >> 1)) & 0x5555555555555555ULL;
+        count += __builtin_popcountll(diff);
+    }
+    return count;
+}
+
+/* 所有序列连续存放在一个 2 位编码的缓冲区里，offsets[i] 是第 i 条序列的起始碱基位置。
+ * 末尾总留一个空字，Word() 跨字读取时不会越界 */
+class PackedDnaStore{
+public:
+    void Reserve(uint64_t bases){
+        words.reserve(bases / 32 + 2);
+    }
+
+    /* 只接受 ACGT，遇到其他字符返回 false，序列不加入 */
+    bool Append(const char *seq, uint32_t length){
+        for(uint32_t k = 0; k < length; k++)
+            if(BaseCode(seq[k]) > 3)
+                return false;
+        uint64_t start = offsets.back();
+        words.resize((start + length) / 32 + 2, 0);
+        for(uint32_t k = 0; k < length; k++){
+            uint64_t pos = start + k;
+            words[pos >> 5] |= (uint64_t)BaseCode(seq[k]) << ((pos & 31) * 2);
+        }
+        offsets.push_back(start + length);
+        return true;
+    }
+
+    uint32_t size() const { return offsets.size() - 1; }
+
+    PackedSeq operator[](uint32_t i) const {
+        return {words.data(), offsets[i], (uint32_t)(offsets[i + 1] - offsets[i])};
+    }
+
+    /* 数据占用的字节数 */
+    size_t Bytes() const {
+        return words.capacity() * sizeof(uint64_t) + offsets.capacity() * sizeof(uint64_t);
+    }
+
+private:
+    std::vector<uint64_t> words = std::vector<uint64_t>(1, 0);
+    std::vector<uint64_t> offsets = std::vector<uint64_t>(1, 0);
+
+    static uint32_t BaseCode(char c){
+        switch(c){
+            case 'A': return 0;
+            case 'C': return 1;
+            case 'G': return 2;
+            case 'T': return 3;
+            default: return 4;
+        }
+    }
+};
+
+/* 多字版本：模式串按 64 位分块，每列自上而下推进各块，块间传递水平差分。
+ * 以下几个距离函数对 std::string 和 PackedSeq 都适用，只要求 size() 和 operator[] */
+template<class Seq>
+uint32_t LevDistBlocks(const Seq &p, const Seq &t){
+    uint32_t m = p.size();
+    uint32_t w = (m + 63) / 64;
+    static thread_local std::vector<uint64_t> scratch;
+    if(scratch.size() < (size_t)(256 + 2) * w)
+        scratch.resize((256 + 2) * w);
+    uint64_t *peq = scratch.data();
+    uint64_t *pv = peq + 256 * w;
+    uint64_t *mv = pv + w;
+    uint32_t n = t.size();
+    for(uint32_t i = 0; i < m; i++)
+        std::fill(peq + (unsigned char)p[i] * w, peq + ((unsigned char)p[i] + 1) * w, 0);
+    for(uint32_t j = 0; j < n; j++)
+        std::fill(peq + (unsigned char)t[j] * w, peq + ((unsigned char)t[j] + 1) * w, 0);
+    for(uint32_t i = 0; i < m; i++)
+        peq[(unsigned char)p[i] * w + i / 64] |= 1ULL << (i % 64);
+    std::fill(pv, pv + w, ~0ULL);
+    std::fill(mv, mv + w, 0);
+
+    uint64_t last_high = 1ULL << ((m - 1) % 64);
+    uint32_t score = m;
+    for(uint32_t j = 0; j < n; j++){
+        const uint64_t *eqs = peq + (unsigned char)t[j] * w;
+        /* 第 0 行 D[0][j] = j，最上面一块的水平差分恒为 +1 */
+        int hin = 1;
+        for(uint32_t k = 0; k < w; k++){
+            uint64_t eq = eqs[k], pvk = pv[k], mvk = mv[k];
+            uint64_t xv = eq | mvk;
+            if(hin < 0)
+                eq |= 1;
+            uint64_t xh = (((eq & pvk) + pvk) ^ pvk) | eq;
+            uint64_t ph = mvk | ~(xh | pvk);
+            uint64_t mh = pvk & xh;
+            uint64_t high = k == w - 1 ? last_high : 1ULL << 63;
+            int hout = (ph & high) ? 1 : ((mh & high) ? -1 : 0);
+            ph <<= 1;
+            mh <<= 1;
+            if(hin < 0)
+                mh |= 1;
+            else if(hin > 0)
+                ph |= 1;
+            pv[k] = mh | ~(xv | ph);
+            mv[k] = ph & xv;
+            hin = hout;
+        }
+        score += hin;
+    }
+    return score;
+}
+
+/* Myers/Hyyrö 位向量编辑距离：较短的串作模式串，逐列推进垂直差分 Pv/Mv，
+ * 模式串不超过 64 时只用一个字，不分配内存 */
+template<class Seq>
+uint32_t LevDist(const Seq &a, const Seq &b){
+    const Seq &p = a.size() <= b.size() ? a : b;
+    const Seq &t = a.size() <= b.size() ? b : a;
+    uint32_t m = p.size();
+    if(m == 0)
+        return t.size();
+    if(m > 64)
+        return LevDistBlocks(p, t);
+
+    /* 只清零两串里出现过的字符 */
+    uint64_t peq[256];
+    uint32_t n = t.size();
+    for(uint32_t i = 0; i < m; i++)
+        peq[(unsigned char)p[i]] = 0;
+    for(uint32_t j = 0; j < n; j++)
+        peq[(unsigned char)t[j]] = 0;
+    for(uint32_t i = 0; i < m; i++)
+        peq[(unsigned char)p[i]] |= 1ULL << i;
+
+    uint64_t pv = ~0ULL, mv = 0;
+    uint64_t high = 1ULL << (m - 1);
+    uint32_t score = m;
+    for(uint32_t j = 0; j < n; j++){
+        uint64_t eq = peq[(unsigned char)t[j]];
+        uint64_t xv = eq | mv;
+        uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+        uint64_t ph = mv | ~(xh | pv);
+        uint64_t mh = pv & xh;
+        if(ph & high)
+            score++;
+        else if(mh & high)
+            score--;
+        ph = (ph << 1) | 1;
+        mh <<= 1;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+    }
+    return score;
+}
+
+/* 2 位编码时字母表只有 4 个碱基，Peq 表只需 4 项；两串都按字取出 32 个碱基后逐 2 位移出，
+ * 不必每个碱基单独定位 */
+template<>
+inline uint32_t LevDist(const PackedSeq &a, const PackedSeq &b){
+    const PackedSeq &p = a.size() <= b.size() ? a : b;
+    const PackedSeq &t = a.size() <= b.size() ? b : a;
+    uint32_t m = p.size(), n = t.size();
+    if(m == 0)
+        return n;
+    if(m > 64)
+        return LevDistBlocks(p, t);
+
+    uint64_t peq[4] = {0, 0, 0, 0};
+    for(uint32_t i = 0; i < m; i += 32){
+        uint64_t word = p.Word(i);
+        for(uint32_t k = i; k < std::min(m, i + 32); k++, word >>= 2)
+            peq[word & 3] |= 1ULL << k;
+    }
+
+    uint64_t pv = ~0ULL, mv = 0;
+    uint64_t high = 1ULL << (m - 1);
+    uint32_t score = m;
+    for(uint32_t j = 0; j < n; j += 32){
+        uint64_t word = t.Word(j);
+        for(uint32_t k = j; k < std::min(n, j + 32); k++, word >>= 2){
+            uint64_t eq = peq[word & 3];
+            uint64_t xv = eq | mv;
+            uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+            uint64_t ph = mv | ~(xh | pv);
+            uint64_t mh = pv & xh;
+            if(ph & high)
+                score++;
+            else if(mh & high)
+                score--;
+            ph = (ph << 1) | 1;
+            mh <<= 1;
+            pv = mh | ~(xv | ph);
+            mv = ph & xv;
+        }
+    }
+    return score;
+}
+
+/* 带阈值的编辑距离：长度差超过 k 直接返回，否则只填对角线两侧宽 2k+1 的带状区域，
+ * 某一行全部超过 k 时提前结束。距离不超过 k 时返回准确值，否则返回 k + 1 */
+template<class Seq>
+uint32_t LevDistWithin(const Seq &a, const Seq &b, uint32_t k){
+    const Seq &s = a.size() <= b.size() ? a : b;
+    const Seq &t = a.size() <= b.size() ? b : a;
+    uint32_t n = s.size(), m = t.size();
+    if(m - n > k)
+        return k + 1;
+    if(n == 0)
+        return m;
+
+    static thread_local std::vector<uint32_t> rows;
+    if(rows.size() < 2 * (size_t)(m + 2))
+        rows.resize(2 * (m + 2));
+    uint32_t *prev = rows.data(), *cur = prev + m + 2;
+    uint32_t over = k + 1;
+    for(uint32_t j = 0; j <= std::min(m, k); j++)
+        prev[j] = j;
+    if(k + 1 <= m)
+        prev[k + 1] = over;
+
+    for(uint32_t i = 1; i <= n; i++){
+        uint32_t lo = i > k + 1 ? i - k : 1, hi = std::min(m, i + k);
+        cur[lo - 1] = lo == 1 ? std::min(i, over) : over;
+        uint32_t row_min = cur[lo - 1];
+        for(uint32_t j = lo; j <= hi; j++){
+            uint32_t d = prev[j - 1] + (s[i - 1] != t[j - 1]);
+            d = std::min(d, prev[j] + 1);
+            d = std::min(d, cur[j - 1] + 1);
+            cur[j] = std::min(d, over);
+            row_min = std::min(row_min, cur[j]);
+        }
+        if(row_min > k)
+            return over;
+        if(hi + 1 <= m)
+            cur[hi + 1] = over;
+        std::swap(prev, cur);
+    }
+    return prev[m];
+}
+
+/* 一条查询序列同时与一批候选序列比较，返回位图，第 l 位为 1 表示第 l 条候选与查询的距离不超过 eps */
+const uint32_t BATCH_LANES = 32;
+
+template<class Seq>
+uint32_t BatchWithinScalar(const Seq &query, const Seq *cands, uint32_t count, uint32_t eps){
+    uint32_t bitmap = 0;
+    for(uint32_t l = 0; l < count; l++)
+        if(LevDistWithin(query, cands[l], eps) <= eps)
+            bitmap |= 1u << l;
+    return bitmap;
+}
+
+/* 把一条序列逐个碱基写到间隔为 stride 的位置上，批量比对时按列转置候选序列用 */
+template<class Seq>
+void FillLane(const Seq &seq, uint8_t *out, uint32_t stride){
+    for(uint32_t k = 0; k < seq.size(); k++)
+        out[(size_t)k * stride] = (uint8_t)seq[k];
+}
+
+/* 打包序列一次取 32 个碱基再拆开，省去逐个碱基的定位 */
+template<>
+inline void FillLane(const PackedSeq &seq, uint8_t *out, uint32_t stride){
+    for(uint32_t k = 0; k < seq.size(); k += 32){
+        uint64_t word = seq.Word(k);
+        uint32_t end = std::min(seq.size() - k, 32u);
+        for(uint32_t b = 0; b < end; b++, word >>= 2)
+            out[(size_t)(k + b) * stride] = word & 3;
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+/* 序列间向量化：每条候选占 AVX2 寄存器的一个 8 位通道，按候选的位置逐列推进整列 DP，
+ * 数值在 eps + 1 处饱和。候选结束后的位置填一个查询里没有的字节，通道走到自己的长度时取出最后一行。
+ * 所有未结束通道的整列最小值都超过 eps 时提前结束。要求查询、候选长度和 eps 都小于 255 */
+template<class Seq>
+__attribute__((target("avx2")))
+uint32_t BatchWithinAVX2(const Seq &query, const Seq *cands, uint32_t count, uint32_t eps){
+    uint32_t m = query.size(), max_length = 0;
+    static thread_local std::vector<uint8_t> query_bytes, columns, rows;
+    query_bytes.resize(m);
+    bool used[256] = {false};
+    for(uint32_t i = 0; i < m; i++){
+        query_bytes[i] = (uint8_t)query[i];
+        used[query_bytes[i]] = true;
+    }
+    uint8_t pad = 0;
+    while(used[pad])
+        pad++;
+
+    // 空闲通道长度记为 0，开始时就算结束，不影响提前结束的判断
+    alignas(32) uint8_t lengths[BATCH_LANES] = {0};
+    for(uint32_t l = 0; l < count; l++){
+        lengths[l] = cands[l].size();
+        max_length = std::max(max_length, cands[l].size());
+    }
+    columns.assign((size_t)max_length * BATCH_LANES, pad);
+    for(uint32_t l = 0; l < count; l++)
+        FillLane(cands[l], &columns[l], BATCH_LANES);
+
+    // rows 存当前列的 D[0..m]，每行 32 个通道
+    rows.resize((size_t)(m + 1) * BATCH_LANES);
+    for(uint32_t i = 0; i <= m; i++)
+        std::fill(&rows[(size_t)i * BATCH_LANES], &rows[(size_t)i * BATCH_LANES] + BATCH_LANES, (uint8_t)std::min(i, eps + 1));
+
+    const __m256i one = _mm256_set1_epi8(1), cap = _mm256_set1_epi8((char)(eps + 1));
+    const __m256i eps_vec = _mm256_set1_epi8((char)eps);
+    const __m256i lens = _mm256_load_si256((const __m256i *)lengths);
+    __m256i *row = (__m256i *)rows.data();
+    __m256i last = _mm256_loadu_si256(row + m);
+    __m256i result = _mm256_blendv_epi8(cap, last, _mm256_cmpeq_epi8(lens, _mm256_setzero_si256()));
+
+    for(uint32_t j = 1; j <= max_length; j++){
+        // 与对角线相距超过 eps 的格子必然大于 eps，只算 [lo, hi] 这一段行，带外按 eps + 1 处理
+        uint32_t lo = j > eps + 1 ? j - eps : 1, hi = std::min(m, j + eps);
+        __m256i c = _mm256_loadu_si256((const __m256i *)&columns[(size_t)(j - 1) * BATCH_LANES]);
+        __m256i diag = _mm256_loadu_si256(row + lo - 1);
+        __m256i left = lo == 1 ? _mm256_set1_epi8((char)std::min(j, eps + 1)) : cap;
+        _mm256_storeu_si256(row + lo - 1, left);
+        __m256i col_min = left;
+        for(uint32_t i = lo; i <= hi; i++){
+            // prev 是上一列同一行 D[i][j-1]
+            __m256i prev = _mm256_loadu_si256(row + i);
+            __m256i cost = _mm256_add_epi8(_mm256_cmpeq_epi8(c, _mm256_set1_epi8((char)query_bytes[i - 1])), one);
+            __m256i v = _mm256_min_epu8(_mm256_adds_epu8(diag, cost), _mm256_adds_epu8(prev, one));
+            v = _mm256_min_epu8(_mm256_min_epu8(v, _mm256_adds_epu8(left, one)), cap);
+            _mm256_storeu_si256(row + i, v);
+            col_min = _mm256_min_epu8(col_min, v);
+            diag = prev;
+            left = v;
+        }
+        if(hi < m || lo > m + 1)
+            left = cap;
+        __m256i j_vec = _mm256_set1_epi8((char)j);
+        result = _mm256_blendv_epi8(result, left, _mm256_cmpeq_epi8(lens, j_vec));
+
+        // 长度大于 j 的通道还没结束，其中整列最小值都超过 eps 的已经不可能在 eps 内
+        __m256i pending = _mm256_andnot_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(lens, j_vec), lens), _mm256_set1_epi8(-1));
+        __m256i hopeful = _mm256_cmpeq_epi8(_mm256_min_epu8(col_min, eps_vec), col_min);
+        if(_mm256_testz_si256(pending, hopeful))
+            break;
+    }
+    __m256i within = _mm256_cmpeq_epi8(_mm256_min_epu8(result, eps_vec), result);
+    uint32_t mask = count == BATCH_LANES ? ~0u : (1u << count) - 1;
+    return (uint32_t)_mm256_movemask_epi8(within) & mask;
+}
+#endif
+
+/* 最多 BATCH_LANES 条候选，CPU 支持 AVX2 且长度都放得进 8 位时走向量版本，否则逐条比较 */
+template<class Seq>
+uint32_t BatchWithin(const Seq &query, const Seq *cands, uint32_t count, uint32_t eps){
+#if defined(__x86_64__) || defined(__i386__)
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    bool fits = has_avx2 && eps < 255 && query.size() < 255;
+    for(uint32_t l = 0; fits && l < count; l++)
+        fits = cands[l].size() < 255;
+    if(fits)
+        return BatchWithinAVX2(query, cands, count, eps);
+#endif
+    return BatchWithinScalar(query, cands, count, eps);
+}
+
+/* 一段连续的下标，指向某个下标缓冲区内部，不拥有内存 */
+struct IdSpan{
+    const uint32_t *first, *last;
+    const uint32_t *begin() const { return first; }
+    const uint32_t *end() const { return last; }
+    uint32_t Size() const { return last - first; }
+};
+
+/* CSR 形式的多个下标列表：第 i 个列表是 ids[offsets[i], offsets[i + 1])，
+ * 邻居表和聚类结果都用它存，不再为每个点分配一个容器 */
+struct IdLists{
+    std::vector<uint32_t> offsets = std::vector<uint32_t>(1, 0);
+    std::vector<uint32_t> ids;
+
+    uint32_t Size() const { return offsets.size() - 1; }
+    IdSpan operator[](uint32_t i) const { return {ids.data() + offsets[i], ids.data() + offsets[i + 1]}; }
+};
+
+/* 与 target_dna 距离不超过 eps 的序列下标，按下标升序。
+ * 等长序列的错配数是编辑距离的上界，不超过 eps 时不必再算距离；
+ * 长度差在 eps 以内的其余序列攒够一批交给 BatchWithin */
+inline std::vector<uint32_t> RangeQuery(const PackedDnaStore &dna_set, const PackedSeq &target_dna, uint32_t eps){
+    std::vector<uint32_t> less_than_eps_ids;
+    PackedSeq batch[BATCH_LANES];
+    uint32_t batch_ids[BATCH_LANES], batch_size = 0;
+    bool sorted = true;
+    auto flush = [&](){
+        uint32_t bitmap = BatchWithin(target_dna, batch, batch_size, eps);
+        for(uint32_t l = 0; l < batch_size; l++)
+            if(bitmap >> l & 1)
+                less_than_eps_ids.push_back(batch_ids[l]);
+        batch_size = 0;
+    };
+    for(uint32_t i = 0; i < dna_set.size(); i++){
+        PackedSeq dna_seq = dna_set[i];
+        uint32_t n = dna_seq.size(), m = target_dna.size();
+        if((n > m ? n - m : m - n) > eps)
+            continue;
+        if(n == m && Mismatches(dna_seq, target_dna) <= eps){
+            sorted = sorted && batch_size == 0;
+            less_than_eps_ids.push_back(i);
+            continue;
+        }
+        batch[batch_size] = dna_seq;
+        batch_ids[batch_size++] = i;
+        if(batch_size == BATCH_LANES)
+            flush();
+    }
+    if(batch_size > 0)
+        flush();
+    if(!sorted)
+        std::sort(less_than_eps_ids.begin(), less_than_eps_ids.end());
+    return less_than_eps_ids;
+}
+
+/* 工作窃取线程池：任务按编号连续分给各线程的队列，线程从自己队列头部取任务，
+ * 自己的做完后从其他队列尾部偷，负载不均时也不会有线程空等 */
+class WorkStealingPool{
+public:
+    explicit WorkStealingPool(uint32_t thread_num) : queues(std::max(thread_num, 1u)){}
+
+    template<class Task>
+    void Run(uint32_t task_num, const Task &task){
+        uint32_t thread_num = queues.size();
+        for(uint32_t t = 0; t < thread_num; t++){
+            queues[t].tasks.clear();
+            for(uint32_t k = (uint64_t)task_num * t / thread_num; k < (uint64_t)task_num * (t + 1) / thread_num; k++)
+                queues[t].tasks.push_back(k);
+        }
+        std::vector<std::thread> workers;
+        for(uint32_t t = 1; t < thread_num; t++)
+            workers.emplace_back([this, t, &task]{ Work(t, task); });
+        Work(0, task);
+        for(auto &worker : workers)
+            worker.join();
+    }
+
+private:
+    struct Queue{
+        std::mutex lock;
+        std::deque<uint32_t> tasks;
+    };
+    std::vector<Queue> queues;
+
+    bool Pop(uint32_t t, uint32_t &k){
+        std::lock_guard<std::mutex> guard(queues[t].lock);
+        if(queues[t].tasks.empty())
+            return false;
+        k = queues[t].tasks.front();
+        queues[t].tasks.pop_front();
+        return true;
+    }
+
+    bool Steal(uint32_t t, uint32_t &k){
+        for(uint32_t s = 1; s < queues.size(); s++){
+            Queue &victim = queues[(t + s) % queues.size()];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if(!victim.tasks.empty()){
+                k = victim.tasks.back();
+                victim.tasks.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    template<class Task>
+    void Work(uint32_t t, const Task &task){
+        uint32_t k;
+        while(Pop(t, k) || Steal(t, k))
+            task(k);
+    }
+};
+
+/* 距离矩阵只存上三角 (i < j)，按行紧凑排列。编辑距离不超过较长串的长度，
+ * 最长串不超过 255 时每项 1 字节，否则 2 字节 */
+class TriDistMatrix{
+public:
+    /* 分块大小：一块 64x64 个距离，足够摊薄调度开销 */
+    static const uint32_t TILE = 64;
+
+    void Compute(const PackedDnaStore &dna_set, uint32_t thread_num){
+        n = dna_set.size();
+        uint32_t max_length = 0;
+        for(uint32_t i = 0; i < n; i++)
+            max_length = std::max(max_length, dna_set[i].size());
+        /* 矩阵每项最多 16 位，更长的序列距离会被截断 */
+        if(max_length > UINT16_MAX){
+            std::cerr << "sequence of length " << max_length << " exceeds " << UINT16_MAX << std::endl;
+            exit(1);
+        }
+        wide_entries = max_length > UINT8_MAX;
+        size_t pair_num = (size_t)n * (n > 0 ? n - 1 : 0) / 2;
+        narrow.assign(wide_entries ? 0 : pair_num, 0);
+        wide.assign(wide_entries ? pair_num : 0, 0);
+
+        /* 只枚举 bi <= bj 的块，对角块内只算 i < j */
+        uint32_t block_num = (n + TILE - 1) / TILE;
+        std::vector<std::pair<uint32_t, uint32_t>> tiles;
+        for(uint32_t bi = 0; bi < block_num; bi++)
+            for(uint32_t bj = bi; bj < block_num; bj++)
+                tiles.emplace_back(bi, bj);
+
+        WorkStealingPool pool(thread_num);
+        pool.Run(tiles.size(), [&](uint32_t k){
+            uint32_t i_end = std::min(n, (tiles[k].first + 1) * TILE);
+            uint32_t j_end = std::min(n, (tiles[k].second + 1) * TILE);
+            for(uint32_t i = tiles[k].first * TILE; i < i_end; i++)
+                for(uint32_t j = std::max(i + 1, tiles[k].second * TILE); j < j_end; j++)
+                    Set(i, j, LevDist(dna_set[i], dna_set[j]));
+        });
+    }
+
+    uint32_t Size() const { return n; }
+
+    uint32_t Get(uint32_t i, uint32_t j) const {
+        if(i == j)
+            return 0;
+        size_t k = i < j ? Offset(i, j) : Offset(j, i);
+        return wide_entries ? wide[k] : narrow[k];
+    }
+
+    /* 第 i 行全部距离（含自身的 0） */
+    void Row(uint32_t i, std::vector<uint32_t> &row) const {
+        row.resize(n);
+        for(uint32_t j = 0; j < n; j++)
+            row[j] = Get(i, j);
+    }
+
+private:
+    uint32_t n = 0;
+    bool wide_entries = false;
+    std::vector<uint8_t> narrow;
+    std::vector<uint16_t> wide;
+
+    size_t Offset(uint32_t i, uint32_t j) const {
+        return (size_t)i * n - (size_t)i * (i + 1) / 2 + (j - i - 1);
+    }
+
+    void Set(uint32_t i, uint32_t j, uint32_t dist){
+        size_t k = Offset(i, j);
+        if(wide_entries)
+            wide[k] = dist;
+        else
+            narrow[k] = dist;
+    }
+};
+
+/* dist_vec 须由调用方先对 dna_set 算好，MinEPS 还要接着用。返回的每个簇是一段序列下标 */
+inline IdLists DBSCAN(
+        const PackedDnaStore &dna_set,
+        uint32_t eps, uint32_t minpts, uint32_t &num_cores, uint32_t &num_borders,
+        uint32_t &num_outliers, uint32_t &num_clusters,
+        std::vector<uint32_t> &point_class, const TriDistMatrix &dist_vec){
+    if(dist_vec.Size() != dna_set.size()){
+        std::cerr << "distance matrix has " << dist_vec.Size() << " rows for " << dna_set.size() << " sequences" << std::endl;
+        exit(1);
+    }
+    uint32_t dna_num = dna_set.size();
+    // 记录每个点在其半径为 eps 的圆形范围内的点（不含自身），CSR 形式，每个列表内下标升序
+    IdLists less_than_eps;
+    std::vector<bool> point_reached = std::vector<bool>(dna_num, false);
+    IdLists clusters;
+
+    // STEP1: 由距离矩阵建邻居表, 先数出每个点的邻居个数, 再按行填入
+    less_than_eps.offsets.assign(dna_num + 1, 0);
+    for(uint32_t i = 0; i < dna_num; i++)
+        for(uint32_t j = i + 1; j < dna_num; j++)
+            if(dist_vec.Get(i, j) <= eps){
+                less_than_eps.offsets[i + 1]++;
+                less_than_eps.offsets[j + 1]++;
+            }
+    for(uint32_t i = 0; i < dna_num; i++)
+        less_than_eps.offsets[i + 1] += less_than_eps.offsets[i];
+    less_than_eps.ids.resize(less_than_eps.offsets[dna_num]);
+    std::vector<uint32_t> fill(less_than_eps.offsets.begin(), less_than_eps.offsets.end() - 1);
+    for(uint32_t i = 0; i < dna_num; i++)
+        for(uint32_t j = i + 1; j < dna_num; j++)
+            if(dist_vec.Get(i, j) <= eps){
+                less_than_eps.ids[fill[i]++] = j;
+                less_than_eps.ids[fill[j]++] = i;
+            }
+
+    // STEP2: 判断点的类型
+    for(uint32_t i = 0; i < dna_num; i++)
+        if(less_than_eps[i].Size() + 1 >= minpts){
+            point_class[i] = CORE_POINT;
+            for(auto point : less_than_eps[i])
+                if (point_class[point] != CORE_POINT)
+                    point_class[point] = BORDER_POINT;
+        }
+
+    // STEP3: 计数
+    for(uint32_t i = 0; i < dna_num; i++){
+        if(point_class[i] == CORE_POINT)
+            num_cores ++;
+        else if(point_class[i] == BORDER_POINT)
+            num_borders ++;
+        else
+            num_outliers ++;
+    }
+
+    // STEP4: 使用深度优先搜索进行聚类。图上的边是核心点与其邻域内各点之间的边，
+    // 所以核心点走向全部邻居，非核心点只走向邻域内的核心点
+    for(uint32_t i = 0; i < dna_num; i++)
+        if(point_class[i] != OUTLIER_POINT && !point_reached[i]){
+            std::stack<uint32_t> point_stack;
+            point_stack.push(i);
+            point_reached[i] = true;
+            clusters.ids.push_back(i);
+            while(!point_stack.empty()){
+                uint32_t point = point_stack.top();
+                point_stack.pop();
+                for(auto near_point : less_than_eps[point])
+                    if(!point_reached[near_point] &&
+                       (point_class[point] == CORE_POINT || point_class[near_point] == CORE_POINT)){
+                        point_reached[near_point] = true;
+                        point_stack.push(near_point);
+                        clusters.ids.push_back(near_point);
+                    }
+            }
+            clusters.offsets.push_back(clusters.ids.size());
+        }
+    num_clusters = clusters.Size();
+    return clusters;
+}
+
+/* 每个点到第 minpts - 1 近的其他点的距离，即该点成为 CORE_POINT 所需的最小 eps。
+ * 每行用 nth_element 做部分选择，不必整行排序；其他点不够时为 UINT32_MAX */
+inline std::vector<uint32_t> CoreDistances(const TriDistMatrix &dist_vec, uint32_t minpts){
+    uint32_t dna_num = dist_vec.Size();
+    std::vector<uint32_t> core_dist(dna_num, minpts <= 1 ? 0 : UINT32_MAX);
+    if(minpts <= 1 || minpts > dna_num)
+        return core_dist;
+    std::vector<uint32_t> row;
+    for(uint32_t i = 0; i < dna_num; i++){
+        dist_vec.Row(i, row);
+        /* 行内包含自身的 0，第 minpts - 1 小的值正是第 minpts - 1 近的其他点 */
+        std::nth_element(row.begin(), row.begin() + (minpts - 1), row.end());
+        core_dist[i] = row[minpts - 1];
+    }
+    return core_dist;
+}
+
+inline uint32_t MinEPS(const PackedDnaStore &dna_set, uint32_t minpts,
+                uint32_t prev_eps,const std::vector<uint32_t> &point_class,
+                const TriDistMatrix &dist_vec){
+    if(dist_vec.Size() != dna_set.size()){
+        std::cerr << "distance matrix has " << dist_vec.Size() << " rows for " << dna_set.size() << " sequences" << std::endl;
+        exit(1);
+    }
+    //每个点作为CORE_POINT所需的eps只算一次
+    std::vector<uint32_t> core_dist = CoreDistances(dist_vec, minpts);
+    //记录擦除掉每个OUTLIER_POINT需要的最小eps, 只保留最大的那个
+    bool has_outlier = false;
+    uint32_t max_new_eps = 0;
+    for(uint32_t i = 0; i < dna_set.size(); i++)
+        if(point_class[i] == OUTLIER_POINT){
+            has_outlier = true;
+            //该OUTLIER_POINT作为CORE_POINT的情况
+            uint32_t new_min_eps_of_point = core_dist[i];
+
+            //该OUTLIER_POINT作为BORDER_POINT的情况
+            for(uint32_t j = 0; j < dna_set.size(); j++){
+                if(core_dist[j] >= new_min_eps_of_point)
+                    continue;
+                uint32_t new_min_eps_core_j = std::max(core_dist[j], dist_vec.Get(j, i));
+                if(new_min_eps_of_point > new_min_eps_core_j) new_min_eps_of_point = new_min_eps_core_j;
+            }
+            max_new_eps = std::max(max_new_eps, new_min_eps_of_point);
+        }
+    //针对无OUTLIER_POINT的情况
+    if(!has_outlier) return prev_eps;
+    return max_new_eps;
+}
+
+#endif
@@ -8,6 +8,12 @@
 #include <cmath>
 #include <numeric>
 #include <climits>
+#include <cstdint>
+#include <atomic>
+#include <thread>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
 using namespace std;
 
@@ -43,132 +49,821 @@ void LoadData() {
     cout << min_len << " " << max_len << endl;
 }
 
+// 多字版本：模式串按 64 位分块，每列自上而下推进各块，块间传递水平差分（Myers 1999）。
+// 查找表放在线程私有的缓冲区里反复使用，只在第一次遇到更长的串时扩容
+int LevDistBlocks(const string &p, const string &t) {
+    int m = p.length();
+    int w = (m + 63) / 64;
+    static thread_local vector<uint64_t> scratch;
+    if (scratch.size() < (size_t)(256 + 2) * w) scratch.resize((256 + 2) * w);
+    uint64_t *peq = scratch.data();
+    uint64_t *pv = peq + 256 * w;
+    uint64_t *mv = pv + w;
+
+    for (unsigned char c : p) fill(peq + c * w, peq + (c + 1) * w, 0);
+    for (unsigned char c : t) fill(peq + c * w, peq + (c + 1) * w, 0);
+    for (int i = 0; i < m; i++) peq[(unsigned char)p[i] * w + i / 64] |= 1ULL << (i % 64);
+    fill(pv, pv + w, ~0ULL);
+    fill(mv, mv + w, 0);
+
+    uint64_t last_high = 1ULL << ((m - 1) % 64);
+    int score = m;
+    for (unsigned char c : t) {
+        const uint64_t *eqs = peq + c * w;
+        // 第 0 行 D[0][j] = j，最上面一块的水平差分恒为 +1
+        int hin = 1;
+        for (int k = 0; k < w; k++) {
+            uint64_t eq = eqs[k], pvk = pv[k], mvk = mv[k];
+            uint64_t xv = eq | mvk;
+            if (hin < 0) eq |= 1;
+            uint64_t xh = (((eq & pvk) + pvk) ^ pvk) | eq;
+            uint64_t ph = mvk | ~(xh | pvk);
+            uint64_t mh = pvk & xh;
+            uint64_t high = k == w - 1 ? last_high : 1ULL << 63;
+            int hout = (ph & high) ? 1 : ((mh & high) ? -1 : 0);
+            ph <<= 1;
+            mh <<= 1;
+            if (hin < 0) mh |= 1;
+            else if (hin > 0) ph |= 1;
+            pv[k] = mh | ~(xv | ph);
+            mv[k] = ph & xv;
+            hin = hout;
+        }
+        score += hin;
+    }
+    return score;
+}
+
+// Myers/Hyyrö 位向量编辑距离：较短的串作模式串，第 i 位表示第 i 行，
+// 逐列推进垂直差分 Pv/Mv，同时跟踪最后一行的值。模式串不超过 64 时只用一个字，不分配内存
 int LevDist(const string &a, const string &b) {
-    vector<vector<int>> dp(a.length() + 1, vector<int>(b.length() + 1, 0));
+    const string &p = a.length() <= b.length() ? a : b;
+    const string &t = a.length() <= b.length() ? b : a;
+    int m = p.length();
+    if (m == 0) return t.length();
+    if (m > 64) return LevDistBlocks(p, t);
+
+    // 只清零两串里出现过的字符，不必整表初始化
+    uint64_t peq[256];
+    for (unsigned char c : p) peq[c] = 0;
+    for (unsigned char c : t) peq[c] = 0;
+    for (int i = 0; i < m; i++) peq[(unsigned char)p[i]] |= 1ULL << i;
+
+    uint64_t pv = ~0ULL, mv = 0;
+    uint64_t high = 1ULL << (m - 1);
+    int score = m;
+    for (unsigned char c : t) {
+        uint64_t eq = peq[c];
+        uint64_t xv = eq | mv;
+        uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+        uint64_t ph = mv | ~(xh | pv);
+        uint64_t mh = pv & xh;
+        if (ph & high) score++;
+        else if (mh & high) score--;
+        ph = (ph << 1) | 1;
+        mh <<= 1;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+    }
+    return score;
+}
+
+// 带阈值的编辑距离：只关心结果是否不超过 k 时使用。长度差超过 k 直接返回，
+// 否则只填主对角线两侧宽 2k+1 的带状区域，某一行全部超过 k 时提前结束。
+// 距离不超过 k 时返回准确值，否则返回 k + 1
+int LevDistWithin(const string &a, const string &b, int k) {
+    const string &s = a.length() <= b.length() ? a : b;
+    const string &t = a.length() <= b.length() ? b : a;
+    int n = s.length(), m = t.length();
+    if (m - n > k) return k + 1;
+    if (n == 0) return m;
+
+    static thread_local vector<int> rows;
+    if (rows.size() < 2 * (size_t)(m + 2)) rows.resize(2 * (m + 2));
+    int *prev = rows.data(), *cur = prev + m + 2;
+    int over = k + 1;
+    for (int j = 0; j <= min(m, k); j++) prev[j] = j;
+    if (k + 1 <= m) prev[k + 1] = over;
+
+    for (int i = 1; i <= n; i++) {
+        int lo = max(1, i - k), hi = min(m, i + k);
+        cur[lo - 1] = lo == 1 ? min(i, over) : over;
+        int row_min = cur[lo - 1];
+        for (int j = lo; j <= hi; j++) {
+            int d = prev[j - 1] + (s[i - 1] != t[j - 1]);
+            d = min(d, prev[j] + 1);
+            d = min(d, cur[j - 1] + 1);
+            cur[j] = min(d, over);
+            row_min = min(row_min, cur[j]);
+        }
+        if (row_min > k) return over;
+        if (hi + 1 <= m) cur[hi + 1] = over;
+        swap(prev, cur);
+    }
+    return prev[m];
+}
+
+// 批量验证：target 同时与 dna_set 中的一批序列 ids[0, count) 比较，count 不超过 BATCH_LANES。
+// 返回位图，第 l 位为 1 表示 ids[l] 与 target 的距离不超过 eps
+const int BATCH_LANES = 32;
+
+uint32_t BatchWithinScalar(const vector<string> &dna_set, const string &target, const int *ids, int count, int eps) {
+    uint32_t bitmap = 0;
+    for (int l = 0; l < count; l++) {
+        if (LevDistWithin(dna_set[ids[l]], target, eps) <= eps) bitmap |= 1u << l;
+    }
+    return bitmap;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// 序列间向量化：每条候选占 AVX2 寄存器的一个 8 位通道，按候选的位置逐列推进 DP，
+// 每列只算对角线两侧 eps 以内的行，数值在 eps + 1 处饱和。候选结束后填一个 target 里没有的字节，
+// 通道走到自己的长度时取出最后一行；未结束的通道整列都超过 eps 时提前结束。
+// 要求 target、候选长度和 eps 都小于 255
+__attribute__((target("avx2")))
+uint32_t BatchWithinAVX2(const vector<string> &dna_set, const string &target, const int *ids, int count, int eps) {
+    int m = target.length(), max_length = 0;
+    bool used[256] = {false};
+    for (unsigned char ch : target) used[ch] = true;
+    unsigned char pad = 0;
+    while (used[pad]) pad++;
+
+    // 空闲通道长度记为 0，开始时就算结束，不影响提前结束的判断
+    alignas(32) uint8_t lengths[BATCH_LANES] = {0};
+    for (int l = 0; l < count; l++) {
+        lengths[l] = dna_set[ids[l]].length();
+        max_length = max(max_length, (int)lengths[l]);
+    }
+    static thread_local vector<uint8_t> columns, rows;
+    columns.assign((size_t)max_length * BATCH_LANES, pad);
+    for (int l = 0; l < count; l++) {
+        const string &s = dna_set[ids[l]];
+        for (int k = 0; k < s.length(); k++) columns[(size_t)k * BATCH_LANES + l] = s[k];
+    }
+    // rows 存当前列的 D[0..m]，每行 32 个通道
+    rows.resize((size_t)(m + 1) * BATCH_LANES);
+    for (int i = 0; i <= m; i++) fill_n(&rows[(size_t)i * BATCH_LANES], BATCH_LANES, (uint8_t)min(i, eps + 1));
+
+    const __m256i one = _mm256_set1_epi8(1), cap = _mm256_set1_epi8((char)(eps + 1));
+    const __m256i eps_vec = _mm256_set1_epi8((char)eps);
+    const __m256i lens = _mm256_load_si256((const __m256i *)lengths);
+    __m256i *row = (__m256i *)rows.data();
+    __m256i result = _mm256_blendv_epi8(cap, _mm256_loadu_si256(row + m), _mm256_cmpeq_epi8(lens, _mm256_setzero_si256()));
+
+    for (int j = 1; j <= max_length; j++) {
+        // 带外的格子必然大于 eps，按 eps + 1 处理
+        int lo = max(1, j - eps), hi = min(m, j + eps);
+        __m256i c = _mm256_loadu_si256((const __m256i *)&columns[(size_t)(j - 1) * BATCH_LANES]);
+        __m256i diag = _mm256_loadu_si256(row + lo - 1);
+        __m256i left = lo == 1 ? _mm256_set1_epi8((char)min(j, eps + 1)) : cap;
+        _mm256_storeu_si256(row + lo - 1, left);
+        __m256i col_min = left;
+        for (int i = lo; i <= hi; i++) {
+            __m256i prev = _mm256_loadu_si256(row + i);  // 上一列同一行
+            __m256i cost = _mm256_add_epi8(_mm256_cmpeq_epi8(c, _mm256_set1_epi8(target[i - 1])), one);
+            __m256i v = _mm256_min_epu8(_mm256_adds_epu8(diag, cost), _mm256_adds_epu8(prev, one));
+            v = _mm256_min_epu8(_mm256_min_epu8(v, _mm256_adds_epu8(left, one)), cap);
+            _mm256_storeu_si256(row + i, v);
+            col_min = _mm256_min_epu8(col_min, v);
+            diag = prev;
+            left = v;
+        }
+        if (hi < m || lo > m + 1) left = cap;
+        __m256i j_vec = _mm256_set1_epi8((char)j);
+        result = _mm256_blendv_epi8(result, left, _mm256_cmpeq_epi8(lens, j_vec));
+
+        // 长度大于 j 的通道还没结束，其中整列都超过 eps 的已经不可能在 eps 内
+        __m256i pending = _mm256_andnot_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(lens, j_vec), lens), _mm256_set1_epi8(-1));
+        __m256i hopeful = _mm256_cmpeq_epi8(_mm256_min_epu8(col_min, eps_vec), col_min);
+        if (_mm256_testz_si256(pending, hopeful)) break;
+    }
+    __m256i within = _mm256_cmpeq_epi8(_mm256_min_epu8(result, eps_vec), result);
+    uint32_t mask = count == BATCH_LANES ? ~0u : (1u << count) - 1;
+    return (uint32_t)_mm256_movemask_epi8(within) & mask;
+}
+#endif
+
+// CPU 支持 AVX2 且长度都放得进 8 位时走向量版本，否则逐条比较
+uint32_t BatchWithin(const vector<string> &dna_set, const string &target, const int *ids, int count, int eps) {
+#if defined(__x86_64__) || defined(__i386__)
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    bool fits = has_avx2 && eps < 255 && target.length() < 255;
+    for (int l = 0; fits && l < count; l++) fits = dna_set[ids[l]].length() < 255;
+    if (fits) return BatchWithinAVX2(dna_set, target, ids, count, eps);
+#endif
+    return BatchWithinScalar(dna_set, target, ids, count, eps);
+}
 
-    for (int i = 0; i <= a.length(); i++) {
-        dp[i][0] = i;
+// 把 ids 中与 target 距离不超过 eps 的按原顺序追加到 out
+void VerifyWithin(const vector<string> &dna_set, const string &target, const vector<int> &ids, int eps, vector<int> &out) {
+    for (int first = 0; first < ids.size(); first += BATCH_LANES) {
+        int count = min(BATCH_LANES, (int)ids.size() - first);
+        uint32_t bitmap = BatchWithin(dna_set, target, ids.data() + first, count, eps);
+        for (int l = 0; l < count; l++) {
+            if (bitmap >> l & 1) out.push_back(ids[first + l]);
+        }
     }
-    for (int j = 0; j <= b.length(); j++) {
-        dp[0][j] = j;
+}
+
+// BK 树：以编辑距离为度量的索引。子节点挂在与父节点距离为 d 的边上，
+// 半径 eps 的查询由三角不等式只需进入 |d - dist(q, 父)| <= eps 的子树
+struct BKTree {
+    struct Node {
+        int id;       // 在 dna_set 中的下标
+        int dist;     // 与父节点的编辑距离
+        int child;    // 第一个子节点，-1 表示没有
+        int sibling;  // 下一个兄弟节点
+    };
+
+    const vector<string> *dna_set;
+    vector<Node> nodes;
+
+    BKTree(const vector<string> &set) : dna_set(&set) {
+        nodes.reserve(set.size());
+        for (int i = 0; i < set.size(); i++) insert(i);
     }
 
-    for (int i = 1; i <= a.length(); i++) {
-        for (int j = 1; j <= b.length(); j++) {
-            dp[i][j] = min(dp[i - 1][j] + 1, dp[i][j - 1] + 1);
+    void insert(int id) {
+        int added = nodes.size();
+        nodes.push_back({id, 0, -1, -1});
+        if (added == 0) return;
+
+        const string &seq = (*dna_set)[id];
+        int cur = 0;
+        while (true) {
+            int d = LevDist((*dna_set)[nodes[cur].id], seq);
+            int c = nodes[cur].child;
+            while (c != -1 && nodes[c].dist != d) c = nodes[c].sibling;
+            if (c == -1) {
+                nodes[added].dist = d;
+                nodes[added].sibling = nodes[cur].child;
+                nodes[cur].child = added;
+                return;
+            }
+            cur = c;
+        }
+    }
 
-            if (a[i - 1] == b[j - 1]) {
-                dp[i][j] = min(dp[i][j], dp[i - 1][j - 1]);
-            } else {
-                dp[i][j] = min(dp[i][j], dp[i - 1][j - 1] + 1);
+    // 把与 target 距离不超过 eps 的下标写入 out（包括 target 自身所在的下标）
+    void query(const string &target, int eps, vector<int> &out) const {
+        out.clear();
+        if (nodes.empty()) return;
+        static thread_local vector<int> todo;
+        todo.assign(1, 0);
+        while (!todo.empty()) {
+            const Node &node = nodes[todo.back()];
+            todo.pop_back();
+            // 叶子节点不需要准确距离来剪枝，用带阈值的版本即可
+            if (node.child == -1) {
+                if (LevDistWithin((*dna_set)[node.id], target, eps) <= eps) out.push_back(node.id);
+                continue;
+            }
+            int d = LevDist((*dna_set)[node.id], target);
+            if (d <= eps) out.push_back(node.id);
+            for (int c = node.child; c != -1; c = nodes[c].sibling) {
+                if (abs(nodes[c].dist - d) <= eps) todo.push_back(c);
             }
         }
     }
+};
 
-    return dp[a.length()][b.length()];
+// q-gram 过滤：长度为 m、n 的两串编辑距离不超过 k 时，至少共有
+// max(m, n) - q + 1 - k * q 个 q-gram（按重数计）。序列按 2 位一个碱基编码，
+// 每个 q-gram 是一个 2q 位的整数，倒排表按 CSR 存放 (序列号, 出现次数)，
+// 查询时只把共有数达到下界的序列交给 LevDistWithin 验证
+const int QGRAM_MAX_Q = 8;
+
+int BaseCode(char c) {
+    switch (c) {
+        case 'A': return 0;
+        case 'C': return 1;
+        case 'G': return 2;
+        case 'T': return 3;
+        default: return -1;
+    }
 }
 
-vector<string> RangeQuery(const vector<string> &dna_set, const string &target_dna, int eps) {
-    vector<string> result;
-    for (auto dna : dna_set) {
-        if (LevDist(dna, target_dna) <= eps) {
-            result.push_back(dna);
+// q 越大单个 q-gram 越有区分度，但下界 max(m, n) - q + 1 - k * q 也越小，
+// (k + 1) * q 超过序列长度时就失效了。实测取中位长度所允许最大 q 的一半左右过滤得最多
+int ChooseQ(const vector<string> &dna_set, int eps) {
+    if (dna_set.empty()) return 1;
+    vector<int> lens;
+    for (auto &dna : dna_set) lens.push_back(dna.length());
+    nth_element(lens.begin(), lens.begin() + lens.size() / 2, lens.end());
+    int q = (lens[lens.size() / 2] + eps + 1) / (2 * (eps + 1));
+    return max(1, min(q, QGRAM_MAX_Q));
+}
+
+// 把 seq 的 q-gram 按编码排好并合并成 (编码, 次数)；含非 ACGT 字符时返回 false
+bool GramProfile(const string &seq, int q, vector<pair<uint32_t, int>> &profile) {
+    profile.clear();
+    static thread_local vector<uint32_t> grams;
+    grams.clear();
+    uint32_t mask = (1u << (2 * q)) - 1, code = 0;
+    for (int i = 0; i < seq.length(); i++) {
+        int b = BaseCode(seq[i]);
+        if (b < 0) return false;
+        code = ((code << 2) | b) & mask;
+        if (i + 1 >= q) grams.push_back(code);
+    }
+    sort(grams.begin(), grams.end());
+    for (uint32_t g : grams) {
+        if (!profile.empty() && profile.back().first == g) profile.back().second++;
+        else profile.push_back({g, 1});
+    }
+    return true;
+}
+
+struct QGramIndex {
+    const vector<string> *dna_set;
+    int q;
+    vector<int> offsets;             // 每个 q-gram 编码在 postings 中的起点，共 4^q + 1 项
+    vector<pair<int, int>> postings; // (序列号, 出现次数)
+    vector<int> unfiltered;          // 含非 ACGT 字符、不参与过滤的序列
+    vector<vector<int>> by_length;   // 按长度分桶，处理下界不为正的短序列
+
+    // 查询可能来自多个线程，计数用原子变量
+    mutable atomic<long long> pairs_total{0};     // 经过过滤的 (查询, 序列) 对数
+    mutable atomic<long long> pairs_verified{0};  // 其中需要精确验证的对数
+
+    QGramIndex(const vector<string> &set, int q) : dna_set(&set), q(q) {
+        int n = set.size();
+        vector<vector<pair<uint32_t, int>>> profiles(n);
+        offsets.assign((1 << (2 * q)) + 1, 0);
+        for (int i = 0; i < n; i++) {
+            if (!GramProfile(set[i], q, profiles[i])) {
+                unfiltered.push_back(i);
+                continue;
+            }
+            if (set[i].length() >= by_length.size()) by_length.resize(set[i].length() + 1);
+            by_length[set[i].length()].push_back(i);
+            for (auto &g : profiles[i]) offsets[g.first + 1]++;
+        }
+        partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+        postings.resize(offsets.back());
+        vector<int> fill = offsets;
+        for (int i = 0; i < n; i++) {
+            for (auto &g : profiles[i]) postings[fill[g.first]++] = {i, g.second};
+        }
+    }
+
+    // 可能与 target 距离不超过 eps 的序列，结果无序
+    void candidates(const string &target, int eps, vector<int> &out) const {
+        out.clear();
+        const vector<string> &set = *dna_set;
+        int len = target.length();
+        pairs_total += set.size();
+
+        static thread_local vector<pair<uint32_t, int>> profile;
+        static thread_local vector<int> shared;
+        static thread_local vector<int> touched;
+        if (shared.size() < set.size()) shared.resize(set.size(), 0);
+        touched.clear();
+
+        if (!GramProfile(target, q, profile)) {
+            for (int i = 0; i < set.size(); i++) out.push_back(i);
+            pairs_verified += out.size();
+            return;
+        }
+        for (auto &g : profile) {
+            for (int p = offsets[g.first]; p < offsets[g.first + 1]; p++) {
+                int id = postings[p].first;
+                if (shared[id] == 0) touched.push_back(id);
+                shared[id] += min(g.second, postings[p].second);
+            }
+        }
+        for (int id : touched) {
+            int other = set[id].length();
+            int need = max(len, other) - q + 1 - eps * q;
+            if (abs(len - other) <= eps && shared[id] >= need) out.push_back(id);
+        }
+        // 两串都很短时下界不为正，这些序列即使没有公共 q-gram 也得保留
+        int short_len = (eps + 1) * q - 1;
+        if (len <= short_len) {
+            int hi = min(short_len, len + eps);
+            for (int l = max(0, len - eps); l <= hi && l < by_length.size(); l++) {
+                for (int id : by_length[l]) {
+                    if (shared[id] == 0) out.push_back(id);
+                }
+            }
         }
+        for (int id : touched) shared[id] = 0;
+        for (int id : unfiltered) out.push_back(id);
+        pairs_verified += out.size();
+    }
+
+    void query(const string &target, int eps, vector<int> &out) const {
+        static thread_local vector<int> cand;
+        candidates(target, eps, cand);
+        out.clear();
+        VerifyWithin(*dna_set, target, cand, eps, out);
+    }
+
+    double pruned_fraction() const {
+        return pairs_total == 0 ? 0 : 1.0 - (double)pairs_verified / pairs_total;
+    }
+};
+
+// 一段连续的下标，指向某个下标缓冲区内部，不拥有内存
+struct IdSpan {
+    const int *first, *last;
+    const int *begin() const { return first; }
+    const int *end() const { return last; }
+    int size() const { return last - first; }
+};
+
+// CSR 形式的多个下标列表：第 i 个列表是 ids[offsets[i], offsets[i + 1])。
+// 邻居表和聚类结果都用它存，整体只有两次分配，也不复制字符串
+struct IdLists {
+    vector<int> offsets{0};
+    vector<int> ids;
+
+    int size() const { return offsets.size() - 1; }
+    IdSpan operator[](int i) const { return {ids.data() + offsets[i], ids.data() + offsets[i + 1]}; }
+};
+
+// 与 target_dna 距离不超过 eps 的序列下标，按下标升序。长度差超过 eps 的直接跳过，其余成批验证
+vector<int> RangeQueryIds(const vector<string> &dna_set, const string &target_dna, int eps) {
+    static thread_local vector<int> cand;
+    cand.clear();
+    for (int i = 0; i < dna_set.size(); i++) {
+        if (abs((int)dna_set[i].length() - (int)target_dna.length()) <= eps) cand.push_back(i);
     }
+    vector<int> result;
+    VerifyWithin(dna_set, target_dna, cand, eps, result);
     return result;
 }
 
-struct DSU {
-    vector<int> parent;
-    int components;
+// 已建好索引时的版本，只访问索引无法排除的序列
+template <class Index>
+vector<int> RangeQueryIds(const Index &index, const string &target_dna, int eps) {
+    vector<int> result;
+    index.query(target_dna, eps, result);
+    sort(result.begin(), result.end());
+    return result;
+}
 
-    DSU(int n) {
-        parent.resize(n + 1);
-        iota(parent.begin(), parent.end(), 0);
-        components = n;
+vector<string> RangeQuery(const vector<string> &dna_set, const string &target_dna, int eps) {
+    vector<string> result;
+    for (int id : RangeQueryIds(dna_set, target_dna, eps)) {
+        result.push_back(dna_set[id]);
     }
+    return result;
+}
+
+// 把 [0, n) 分成小块，各线程用原子计数器领取，f 必须可以并发调用
+template <class F>
+void ParallelFor(int n, const F &f) {
+    const int CHUNK = 16;
+    int threads = max(1u, thread::hardware_concurrency());
+    atomic<int> next(0);
+    auto work = [&]() {
+        while (true) {
+            int begin = next.fetch_add(CHUNK);
+            if (begin >= n) return;
+            for (int i = begin; i < min(n, begin + CHUNK); i++) f(i);
+        }
+    };
+    vector<thread> pool;
+    for (int t = 1; t < threads; t++) pool.emplace_back(work);
+    work();
+    for (auto &th : pool) th.join();
+}
+
+// 无锁并查集：每个节点一个 64 位原子字，高 32 位是秩，低 32 位是父节点。
+// 合并时按 (秩, 下标) 的全序把较小的根挂到较大的根下，CAS 比较整个字，
+// 所以根的秩在读取后变化时会重试，不会成环；秩相同时再尝试给新根的秩加一。
+// 查找用 CAS 做路径减半，失败只说明别的线程已经改过，不影响正确性
+struct ConcurrentDSU {
+    vector<atomic<uint64_t>> nodes;
+    atomic<int> components;
 
-    int find(int i) {
-        if (parent[i] == i) return i;
-        return parent[i] = find(parent[i]);
+    ConcurrentDSU(int n) : nodes(n), components(n) {
+        for (int i = 0; i < n; i++) nodes[i].store(i);
     }
 
-    void unite(int i, int j) {
-        int root_i = find(i);
-        int root_j = find(j);
+    static int parent_of(uint64_t w) { return (uint32_t)w; }
+    static uint32_t rank_of(uint64_t w) { return w >> 32; }
+    static uint64_t word(uint32_t rank, int parent) { return ((uint64_t)rank << 32) | (uint32_t)parent; }
+
+    int find(int x) {
+        while (true) {
+            uint64_t w = nodes[x].load();
+            int p = parent_of(w);
+            if (p == x) return x;
+            int gp = parent_of(nodes[p].load());
+            if (gp != p) nodes[x].compare_exchange_weak(w, word(rank_of(w), gp));
+            x = gp;
+        }
+    }
 
-        if (root_i != root_j) {
-            parent[root_i] = root_j;
+    bool unite(int x, int y) {
+        while (true) {
+            x = find(x);
+            y = find(y);
+            if (x == y) return false;
+            uint64_t wx = nodes[x].load(), wy = nodes[y].load();
+            if (parent_of(wx) != x || parent_of(wy) != y) continue;
+            if (rank_of(wx) > rank_of(wy) || (rank_of(wx) == rank_of(wy) && x > y)) {
+                swap(x, y);
+                swap(wx, wy);
+            }
+            if (!nodes[x].compare_exchange_strong(wx, word(rank_of(wx), y))) continue;
+            if (rank_of(wx) == rank_of(wy)) nodes[y].compare_exchange_strong(wy, word(rank_of(wy) + 1, y));
             components--;
-        } 
+            return true;
+        }
     }
 };
 
-vector<vector<string>> DBSCAN(const vector<string> &dna_set,
+// 每个点的邻居下标（包括自身），按 CSR 存放。每 BLOCK 个点一块并行查询，
+// 块内结果先写进该块自己的缓冲区，最后按块的顺序拼接
+template <class Index>
+IdLists NeighborLists(const Index &index, int eps) {
+    const int BLOCK = 64;
+    const vector<string> &dna_set = *index.dna_set;
+    int n = dna_set.size();
+    int blocks = (n + BLOCK - 1) / BLOCK;
+    vector<vector<int>> block_ids(blocks);
+    vector<int> counts(n);
+    ParallelFor(blocks, [&](int b) {
+        vector<int> found;
+        for (int i = b * BLOCK; i < min(n, (b + 1) * BLOCK); i++) {
+            index.query(dna_set[i], eps, found);
+            counts[i] = found.size();
+            block_ids[b].insert(block_ids[b].end(), found.begin(), found.end());
+        }
+    });
+
+    IdLists lists;
+    lists.offsets.resize(n + 1);
+    partial_sum(counts.begin(), counts.end(), lists.offsets.begin() + 1);
+    lists.ids.reserve(lists.offsets[n]);
+    for (auto &ids : block_ids) {
+        lists.ids.insert(lists.ids.end(), ids.begin(), ids.end());
+        vector<int>().swap(ids);
+    }
+    return lists;
+}
+
+// 按簇号做一次计数排序，簇内下标保持升序；cluster_id 为 -1 的点不属于任何簇
+IdLists GroupByCluster(const vector<int> &cluster_id, int num_clusters) {
+    int n = cluster_id.size();
+    IdLists clusters;
+    clusters.offsets.assign(num_clusters + 1, 0);
+    for (int i = 0; i < n; i++) {
+        if (cluster_id[i] != -1) clusters.offsets[cluster_id[i] + 1]++;
+    }
+    partial_sum(clusters.offsets.begin(), clusters.offsets.end(), clusters.offsets.begin());
+    clusters.ids.resize(clusters.offsets[num_clusters]);
+    vector<int> fill(clusters.offsets.begin(), clusters.offsets.end() - 1);
+    for (int i = 0; i < n; i++) {
+        if (cluster_id[i] != -1) clusters.ids[fill[cluster_id[i]]++] = i;
+    }
+    return clusters;
+}
+
+// 每个点只查询一次索引，邻居表同时用于判断核心点、边界点和合并核心点。
+// Index 可以是 BKTree 或 QGramIndex，只需提供 dna_set 和 query(target, eps, out)。
+// 返回的每个簇是一段序列下标：簇按其中最小的核心点下标编号，边界点归入相邻核心点中编号最小的簇
+template <class Index>
+IdLists DBSCAN(const Index &index,
                                                 int eps,
                                                 int minpts,
                                                 int &num_cores,
                                                 int &num_borders,
                                                 int &num_outliers,
                                                 int &num_clusters) {
-    vector<int> type(dna_set.size(), 0);
-    vector<int> cores;
-    for (int i = 0; i < dna_set.size(); i++) {
-        int cnt = 1;
-        for (int j = 0; j < dna_set.size(); j++) {
-            if (j == i) continue;
-            if (LevDist(dna_set[i], dna_set[j]) <= eps) {
-                cnt++;
-                if (cnt >= minpts) break;
-            }
-        }
-        if (cnt >= minpts) {
+    int n = index.dna_set->size();
+    num_cores = 0;
+    num_borders = 0;
+    num_clusters = 0;
+
+    // 邻居表包含点自身，和原来从 1 开始计数一致
+    IdLists neighbors = NeighborLists(index, eps);
+    vector<int> type(n, 0);
+    vector<int> core_id(n, -1);
+    for (int i = 0; i < n; i++) {
+        if (neighbors[i].size() >= minpts) {
             type[i] = 1;
-            num_cores++;
-            cores.push_back(i);
+            core_id[i] = num_cores++;
         }
     }
 
-    for (int i = 0; i < dna_set.size(); i++) {
+    // 各线程扫描核心点的邻居表，遇到核心点对就直接合并
+    ConcurrentDSU dsu(num_cores);
+    ParallelFor(n, [&](int i) {
+        if (type[i] != 1) return;
+        for (int j : neighbors[i]) {
+            if (j > i && type[j] == 1) {
+                dsu.unite(core_id[i], core_id[j]);
+            }
+        }
+    });
+
+    vector<int> cluster_id(n, -1);
+    vector<int> root_cluster(num_cores, -1);
+    for (int i = 0; i < n; i++) {
+        if (type[i] != 1) continue;
+        int root = dsu.find(core_id[i]);
+        if (root_cluster[root] == -1) root_cluster[root] = num_clusters++;
+        cluster_id[i] = root_cluster[root];
+    }
+
+    for (int i = 0; i < n; i++) {
         if (type[i] == 1) continue;
-        for (int j = 0; j < dna_set.size(); j++) {
-            if (j == i || type[j] != 1) continue;
-            if (LevDist(dna_set[i], dna_set[j]) <= eps) {
-                type[i] = 2;
-                num_borders++;
-                break;
+        for (int j : neighbors[i]) {
+            if (type[j] == 1 && (cluster_id[i] == -1 || cluster_id[j] < cluster_id[i])) {
+                cluster_id[i] = cluster_id[j];
             }
         }
+        if (cluster_id[i] != -1) {
+            type[i] = 2;
+            num_borders++;
+        }
+    }
+
+    num_outliers = n - num_cores - num_borders;
+    return GroupByCluster(cluster_id, num_clusters);
+}
+
+IdLists DBSCAN(const vector<string> &dna_set,
+                                                int eps,
+                                                int minpts,
+                                                int &num_cores,
+                                                int &num_borders,
+                                                int &num_outliers,
+                                                int &num_clusters) {
+    QGramIndex index(dna_set, ChooseQ(dna_set, eps));
+    return DBSCAN(index, eps, minpts, num_cores, num_borders, num_outliers, num_clusters);
+}
+
+// 增量 DBSCAN：序列逐条插入，结果与对当前全部序列重新运行 DBSCAN 一致。
+// 插入只会增加邻居数，核心点不会退化，所以每次插入只需
+// 1) 用 BK 树查出新序列的邻域，邻域内各点的邻居数加一；
+// 2) 邻居数达到 minpts 的点（新序列自身或刚好跨过阈值的旧点）升为核心点，
+//    与邻域内的核心点合并，并登记为邻域内非核心点的相邻核心点。
+// 每个点一生只升级一次，升级时再查一次它的邻域，因此每次插入的代价与邻域大小成正比，
+// 外加索引查询本身，不会重扫全部 n 个点
+struct IncrementalDBSCAN {
+    int eps, minpts;
+    vector<string> dna_set;
+    BKTree tree;
+    vector<int> neighbor_count;   // 邻居数，包括自身
+    vector<char> is_core;
+    vector<int> parent;           // 核心点之间的并查集
+    vector<vector<int>> core_adj; // 非核心点的相邻核心点，非空即为边界点
+    int num_cores = 0, num_borders = 0;
+
+    IncrementalDBSCAN(int eps, int minpts) : eps(eps), minpts(minpts), tree(dna_set) {}
+    // tree 记着 dna_set 的地址，不能复制
+    IncrementalDBSCAN(const IncrementalDBSCAN &) = delete;
+    IncrementalDBSCAN &operator=(const IncrementalDBSCAN &) = delete;
+
+    int size() const { return dna_set.size(); }
+
+    int find(int x) {
+        while (parent[x] != x) {
+            parent[x] = parent[parent[x]];
+            x = parent[x];
+        }
+        return x;
+    }
+
+    void unite(int x, int y) {
+        x = find(x);
+        y = find(y);
+        if (x != y) parent[max(x, y)] = min(x, y);
+    }
+
+    // 插入一条序列，返回它的下标
+    int insert(const string &seq) {
+        int x = dna_set.size();
+        dna_set.push_back(seq);
+        tree.insert(x);
+        neighbor_count.push_back(0);
+        is_core.push_back(0);
+        parent.push_back(x);
+        core_adj.emplace_back();
+
+        vector<int> found;
+        tree.query(dna_set[x], eps, found);
+        neighbor_count[x] = found.size();
+        vector<int> promoted;
+        if (neighbor_count[x] >= minpts) promoted.push_back(x);
+        for (int y : found) {
+            if (y == x) continue;
+            if (is_core[y]) add_core_neighbor(x, y);
+            if (++neighbor_count[y] == minpts) promoted.push_back(y);
+        }
+        for (int p : promoted) {
+            if (p != x) tree.query(dna_set[p], eps, found);
+            promote(p, found);
+        }
+        return x;
     }
 
-    num_outliers = dna_set.size() - num_cores - num_borders;
+    void add_core_neighbor(int x, int core) {
+        if (core_adj[x].empty()) num_borders++;
+        core_adj[x].push_back(core);
+    }
+
+    void promote(int p, const vector<int> &neighbors) {
+        is_core[p] = 1;
+        num_cores++;
+        if (!core_adj[p].empty()) num_borders--;
+        vector<int>().swap(core_adj[p]);
+        for (int q : neighbors) {
+            if (q == p) continue;
+            if (is_core[q]) {
+                unite(p, q);
+            } else {
+                add_core_neighbor(q, p);
+            }
+        }
+    }
 
-    DSU dsu(num_cores);
-    for (int i = 0; i < cores.size(); i++) {
-        for (int j = i + 1; j < cores.size(); j++) {
-            if (LevDist(dna_set[cores[i]], dna_set[cores[j]]) <= eps) {
-                dsu.unite(i + 1, j + 1);
+    // 当前的聚类结果，编号规则与 DBSCAN 相同：簇按最小的核心点下标编号，边界点归入相邻簇中编号最小的
+    IdLists snapshot(int &cores, int &borders, int &outliers, int &clusters) {
+        int n = dna_set.size();
+        vector<int> cluster_id(n, -1), root_cluster(n, -1);
+        clusters = 0;
+        for (int i = 0; i < n; i++) {
+            if (!is_core[i]) continue;
+            int root = find(i);
+            if (root_cluster[root] == -1) root_cluster[root] = clusters++;
+            cluster_id[i] = root_cluster[root];
+        }
+        for (int i = 0; i < n; i++) {
+            for (int c : core_adj[i]) {
+                if (cluster_id[i] == -1 || cluster_id[c] < cluster_id[i]) cluster_id[i] = cluster_id[c];
             }
         }
+        cores = num_cores;
+        borders = num_borders;
+        outliers = n - num_cores - num_borders;
+        return GroupByCluster(cluster_id, clusters);
     }
+};
 
-    num_clusters = dsu.components;
-    return vector<vector<string>>();
+// 每个点到第 k 近的其他点的距离：k = 0 时为 0，其他点不足 k 个时为 INT_MAX。
+// 每对只算一次距离，两端各用一个大小为 k 的大根堆做部分选择
+vector<int> KDistances(const vector<string> &dna_set, int k) {
+    int n = dna_set.size();
+    vector<int> kdist(n, k <= 0 ? 0 : INT_MAX);
+    if (k <= 0) return kdist;
+
+    vector<int> heaps((size_t)n * k);
+    vector<int> sizes(n, 0);
+    auto offer = [&](int x, int d) {
+        int *heap = heaps.data() + (size_t)x * k;
+        if (sizes[x] < k) {
+            heap[sizes[x]++] = d;
+            push_heap(heap, heap + sizes[x]);
+        } else if (d < heap[0]) {
+            pop_heap(heap, heap + k);
+            heap[k - 1] = d;
+            push_heap(heap, heap + k);
+        }
+    };
+    for (int i = 0; i < n; i++) {
+        for (int j = i + 1; j < n; j++) {
+            int d = LevDist(dna_set[i], dna_set[j]);
+            offer(i, d);
+            offer(j, d);
+        }
+    }
+    for (int x = 0; x < n; x++) {
+        if (sizes[x] == k) kdist[x] = heaps[(size_t)x * k];
+    }
+    return kdist;
 }
 
+// x 不是离群点当且仅当 x 是核心点 (kdist(x) <= eps)，或者某个核心点 y 满足 d(x, y) <= eps，
+// 所以让 x 不成为离群点的最小 eps 是 need(x) = min(kdist(x), min_y max(kdist(y), d(x, y)))，
+// 答案是所有 need 的最大值（且至少为 1）。按 kdist 从大到小处理，kdist 不超过当前答案的点
+// 不会再改变结果；其余点只需对 kdist(y) < need(x) 的 y 做带阈值的距离检查。
+// minpts 超过点数时没有核心点，不存在这样的 eps，返回 -1
 int MinEPS(const vector<string> &dna_set, int minpts) {
-    int eps = 1;
-    while (1) {
-        int num_cores = 0, num_borders = 0, num_outliers = 0, num_clusters = 0;
-        DBSCAN(dna_set, eps, minpts, num_cores, num_borders, num_outliers, num_clusters);
+    int n = dna_set.size();
+    if (minpts > n) return -1;
+    vector<int> kdist = KDistances(dna_set, minpts - 1);
+
+    vector<int> order(n);
+    iota(order.begin(), order.end(), 0);
+    sort(order.begin(), order.end(), [&](int x, int y) { return kdist[x] > kdist[y]; });
 
-        if (num_outliers > 0) {
-            eps++;
-        } else {
-            break;
+    int eps = 1;
+    for (int x : order) {
+        if (kdist[x] <= eps) break;
+        int need = kdist[x];
+        for (int y = 0; y < n && need > eps; y++) {
+            if (y == x || kdist[y] >= need) continue;
+            int d = LevDistWithin(dna_set[x], dna_set[y], need - 1);
+            need = min(need, max(kdist[y], d));
         }
+        eps = max(eps, need);
     }
-
     return eps;
 }
 
@@ -180,13 +875,14 @@ int main () {
     LevDist(DNAS[0], DNAS[1]);
 
     // 2.3
-    vector<string> dna_set = RangeQuery(DNAS, DNAS[0], E);
-    cout << dna_set.size() << endl;
+    cout << RangeQueryIds(DNAS, DNAS[0], E).size() << endl;
 
     // 2.4
     int num_cores, num_borders, num_outliers, num_clusters;
-    DBSCAN(DNAS, E, P, num_cores, num_borders, num_outliers, num_clusters);
+    QGramIndex index(DNAS, ChooseQ(DNAS, E));
+    DBSCAN(index, E, P, num_cores, num_borders, num_outliers, num_clusters);
     cout << num_cores << " " << num_borders << " " << num_outliers << " " << num_clusters << endl;
+    cerr << "q-gram filter (q = " << index.q << ") pruned " << index.pruned_fraction() * 100 << "% of pairs" << endl;
 
     // 2.5
     int min_eps = MinEPS(DNAS, P);
@@ -3,7 +3,11 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <numeric>
 #include <climits>
+#include <cstdint>
+#include <atomic>
+#include <thread>
 #include <queue>
 #include <unordered_set>
 
@@ -41,56 +45,260 @@ void LoadData() {
 }
 
 // 2.2 编辑距离计算
+// 多字版本：模式串按 64 位分块，每列自上而下推进各块，块间传递水平差分（Myers 1999）。
+// 查找表放在线程私有的缓冲区里反复使用，只在第一次遇到更长的串时扩容
+int LevDistBlocks(const string &p, const string &t) {
+    int m = p.length();
+    int w = (m + 63) / 64;
+    static thread_local vector<uint64_t> scratch;
+    if (scratch.size() < (size_t)(256 + 2) * w) scratch.resize((256 + 2) * w);
+    uint64_t *peq = scratch.data();
+    uint64_t *pv = peq + 256 * w;
+    uint64_t *mv = pv + w;
+
+    for (unsigned char c : p) fill(peq + c * w, peq + (c + 1) * w, 0);
+    for (unsigned char c : t) fill(peq + c * w, peq + (c + 1) * w, 0);
+    for (int i = 0; i < m; i++) peq[(unsigned char)p[i] * w + i / 64] |= 1ULL << (i % 64);
+    fill(pv, pv + w, ~0ULL);
+    fill(mv, mv + w, 0);
+
+    uint64_t last_high = 1ULL << ((m - 1) % 64);
+    int score = m;
+    for (unsigned char c : t) {
+        const uint64_t *eqs = peq + c * w;
+        // 第 0 行 D[0][j] = j，最上面一块的水平差分恒为 +1
+        int hin = 1;
+        for (int k = 0; k < w; k++) {
+            uint64_t eq = eqs[k], pvk = pv[k], mvk = mv[k];
+            uint64_t xv = eq | mvk;
+            if (hin < 0) eq |= 1;
+            uint64_t xh = (((eq & pvk) + pvk) ^ pvk) | eq;
+            uint64_t ph = mvk | ~(xh | pvk);
+            uint64_t mh = pvk & xh;
+            uint64_t high = k == w - 1 ? last_high : 1ULL << 63;
+            int hout = (ph & high) ? 1 : ((mh & high) ? -1 : 0);
+            ph <<= 1;
+            mh <<= 1;
+            if (hin < 0) mh |= 1;
+            else if (hin > 0) ph |= 1;
+            pv[k] = mh | ~(xv | ph);
+            mv[k] = ph & xv;
+            hin = hout;
+        }
+        score += hin;
+    }
+    return score;
+}
+
+// Myers/Hyyrö 位向量编辑距离：较短的串作模式串，第 i 位表示第 i 行，
+// 逐列推进垂直差分 Pv/Mv，同时跟踪最后一行的值。模式串不超过 64 时只用一个字，不分配内存
 int LevDist(const string &a, const string &b) {
-    int m = a.length();
-    int n = b.length();
-    
-    // 创建DP表
-    vector<vector<int>> dp(m + 1, vector<int>(n + 1));
-    
-    // 初始化边界条件
-    for (int i = 0; i <= m; i++) {
-        dp[i][0] = i;
-    }
-    for (int j = 0; j <= n; j++) {
-        dp[0][j] = j;
-    }
-    
-    // 填充DP表
-    for (int i = 1; i <= m; i++) {
-        for (int j = 1; j <= n; j++) {
-            if (a[i-1] == b[j-1]) {
-                dp[i][j] = dp[i-1][j-1];
-            } else {
-                dp[i][j] = min({
-                    dp[i-1][j] + 1,     // 删除
-                    dp[i][j-1] + 1,     // 插入
-                    dp[i-1][j-1] + 1    // 替换
-                });
-            }
+    const string &p = a.length() <= b.length() ? a : b;
+    const string &t = a.length() <= b.length() ? b : a;
+    int m = p.length();
+    if (m == 0) return t.length();
+    if (m > 64) return LevDistBlocks(p, t);
+
+    // 只清零两串里出现过的字符，不必整表初始化
+    uint64_t peq[256];
+    for (unsigned char c : p) peq[c] = 0;
+    for (unsigned char c : t) peq[c] = 0;
+    for (int i = 0; i < m; i++) peq[(unsigned char)p[i]] |= 1ULL << i;
+
+    uint64_t pv = ~0ULL, mv = 0;
+    uint64_t high = 1ULL << (m - 1);
+    int score = m;
+    for (unsigned char c : t) {
+        uint64_t eq = peq[c];
+        uint64_t xv = eq | mv;
+        uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+        uint64_t ph = mv | ~(xh | pv);
+        uint64_t mh = pv & xh;
+        if (ph & high) score++;
+        else if (mh & high) score--;
+        ph = (ph << 1) | 1;
+        mh <<= 1;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+    }
+    return score;
+}
+
+// 带阈值的编辑距离：只关心结果是否不超过 k 时使用。长度差超过 k 直接返回，
+// 否则只填主对角线两侧宽 2k+1 的带状区域，某一行全部超过 k 时提前结束。
+// 距离不超过 k 时返回准确值，否则返回 k + 1
+int LevDistWithin(const string &a, const string &b, int k) {
+    const string &s = a.length() <= b.length() ? a : b;
+    const string &t = a.length() <= b.length() ? b : a;
+    int n = s.length(), m = t.length();
+    if (m - n > k) return k + 1;
+    if (n == 0) return m;
+
+    static thread_local vector<int> rows;
+    if (rows.size() < 2 * (size_t)(m + 2)) rows.resize(2 * (m + 2));
+    int *prev = rows.data(), *cur = prev + m + 2;
+    int over = k + 1;
+    for (int j = 0; j <= min(m, k); j++) prev[j] = j;
+    if (k + 1 <= m) prev[k + 1] = over;
+
+    for (int i = 1; i <= n; i++) {
+        int lo = max(1, i - k), hi = min(m, i + k);
+        cur[lo - 1] = lo == 1 ? min(i, over) : over;
+        int row_min = cur[lo - 1];
+        for (int j = lo; j <= hi; j++) {
+            int d = prev[j - 1] + (s[i - 1] != t[j - 1]);
+            d = min(d, prev[j] + 1);
+            d = min(d, cur[j - 1] + 1);
+            cur[j] = min(d, over);
+            row_min = min(row_min, cur[j]);
+        }
+        if (row_min > k) return over;
+        if (hi + 1 <= m) cur[hi + 1] = over;
+        swap(prev, cur);
+    }
+    return prev[m];
+}
+
+// 一段连续的下标，指向某个下标缓冲区内部，不拥有内存
+struct IdSpan {
+    const int *first, *last;
+    const int *begin() const { return first; }
+    const int *end() const { return last; }
+    int size() const { return last - first; }
+};
+
+// CSR 形式的多个下标列表：第 i 个列表是 ids[offsets[i], offsets[i + 1])。
+// 邻居表和聚类结果都用它存，整体只有两次分配，也不复制字符串
+struct IdLists {
+    vector<int> offsets{0};
+    vector<int> ids;
+
+    int size() const { return offsets.size() - 1; }
+    IdSpan operator[](int i) const { return {ids.data() + offsets[i], ids.data() + offsets[i + 1]}; }
+};
+
+// 2.3 计算相似DNA序列集合，只返回下标，按下标升序
+vector<int> RangeQueryIds(const vector<string> &dna_set, 
+                          const string &target_dna, 
+                          int eps) {
+    vector<int> result;
+    
+    for (int i = 0; i < dna_set.size(); i++) {
+        if (LevDistWithin(dna_set[i], target_dna, eps) <= eps) {
+            result.push_back(i);
         }
     }
     
-    return dp[m][n];
+    return result;
 }
 
-// 2.3 计算相似DNA序列集合
 vector<string> RangeQuery(const vector<string> &dna_set, 
                          const string &target_dna, 
                          int eps) {
     vector<string> result;
-    
-    for (const string &dna : dna_set) {
-        if (LevDist(dna, target_dna) <= eps) {
-            result.push_back(dna);
+    for (int id : RangeQueryIds(dna_set, target_dna, eps)) {
+        result.push_back(dna_set[id]);
+    }
+    return result;
+}
+
+// 把 [0, n) 分成小块，各线程用原子计数器领取，f 必须可以并发调用
+template <class F>
+void ParallelFor(int n, const F &f) {
+    const int CHUNK = 16;
+    int threads = max(1u, thread::hardware_concurrency());
+    atomic<int> next(0);
+    auto work = [&]() {
+        while (true) {
+            int begin = next.fetch_add(CHUNK);
+            if (begin >= n) return;
+            for (int i = begin; i < min(n, begin + CHUNK); i++) f(i);
+        }
+    };
+    vector<thread> pool;
+    for (int t = 1; t < threads; t++) pool.emplace_back(work);
+    work();
+    for (auto &th : pool) th.join();
+}
+
+// 无锁并查集：每个节点一个 64 位原子字，高 32 位是秩，低 32 位是父节点。
+// 合并时按 (秩, 下标) 的全序把较小的根挂到较大的根下，CAS 比较整个字，
+// 所以根的秩在读取后变化时会重试，不会成环；秩相同时再尝试给新根的秩加一。
+// 查找用 CAS 做路径减半，失败只说明别的线程已经改过，不影响正确性
+struct ConcurrentDSU {
+    vector<atomic<uint64_t>> nodes;
+    atomic<int> components;
+
+    ConcurrentDSU(int n) : nodes(n), components(n) {
+        for (int i = 0; i < n; i++) nodes[i].store(i);
+    }
+
+    static int parent_of(uint64_t w) { return (uint32_t)w; }
+    static uint32_t rank_of(uint64_t w) { return w >> 32; }
+    static uint64_t word(uint32_t rank, int parent) { return ((uint64_t)rank << 32) | (uint32_t)parent; }
+
+    int find(int x) {
+        while (true) {
+            uint64_t w = nodes[x].load();
+            int p = parent_of(w);
+            if (p == x) return x;
+            int gp = parent_of(nodes[p].load());
+            if (gp != p) nodes[x].compare_exchange_weak(w, word(rank_of(w), gp));
+            x = gp;
+        }
+    }
+
+    bool unite(int x, int y) {
+        while (true) {
+            x = find(x);
+            y = find(y);
+            if (x == y) return false;
+            uint64_t wx = nodes[x].load(), wy = nodes[y].load();
+            if (parent_of(wx) != x || parent_of(wy) != y) continue;
+            if (rank_of(wx) > rank_of(wy) || (rank_of(wx) == rank_of(wy) && x > y)) {
+                swap(x, y);
+                swap(wx, wy);
+            }
+            if (!nodes[x].compare_exchange_strong(wx, word(rank_of(wx), y))) continue;
+            if (rank_of(wx) == rank_of(wy)) nodes[y].compare_exchange_strong(wy, word(rank_of(wy) + 1, y));
+            components--;
+            return true;
         }
     }
+};
+
+// 每个点的邻居下标（包括自身），按 CSR 存放。每 BLOCK 个点一块并行计算，
+// 块内结果先写进该块自己的缓冲区，最后按块的顺序拼接
+IdLists NeighborLists(const vector<string> &dna_set, int eps) {
+    const int BLOCK = 64;
+    int n = dna_set.size();
+    int blocks = (n + BLOCK - 1) / BLOCK;
+    vector<vector<int>> block_ids(blocks);
+    vector<int> counts(n, 0);
+    ParallelFor(blocks, [&](int b) {
+        for (int i = b * BLOCK; i < min(n, (b + 1) * BLOCK); i++) {
+            for (int j = 0; j < n; j++) {
+                if (LevDistWithin(dna_set[i], dna_set[j], eps) <= eps) {
+                    block_ids[b].push_back(j);
+                    counts[i]++;
+                }
+            }
+        }
+    });
     
-    return result;
+    IdLists lists;
+    lists.offsets.resize(n + 1);
+    partial_sum(counts.begin(), counts.end(), lists.offsets.begin() + 1);
+    lists.ids.reserve(lists.offsets[n]);
+    for (auto &ids : block_ids) {
+        lists.ids.insert(lists.ids.end(), ids.begin(), ids.end());
+        vector<int>().swap(ids);
+    }
+    return lists;
 }
 
-// 2.4 DBSCAN算法实现
-vector<vector<string>> DBSCAN(const vector<string> &dna_set,
+// 2.4 DBSCAN算法实现，每个簇返回为一段序列下标
+IdLists DBSCAN(const vector<string> &dna_set,
                              int eps,
                              int minpts,
                              int &num_cores,
@@ -100,87 +308,75 @@ vector<vector<string>> DBSCAN(const vector<string> &dna_set,
     int n = dna_set.size();
     vector<int> point_type(n, 0); // 0: 未处理, 1: 核心点, 2: 边界点, 3: 噪声点
     vector<int> cluster_id(n, -1); // -1: 未分配簇
-    vector<bool> visited(n, false);
     
     num_cores = 0;
     num_borders = 0;
     num_outliers = 0;
     num_clusters = 0;
     
-    // 第一步：识别核心点
+    // 第一步：并行求每个点的邻居下标（包括自身），识别核心点
+    IdLists neighbors = NeighborLists(dna_set, eps);
+    vector<int> core_id(n, -1);
     for (int i = 0; i < n; i++) {
-        vector<string> neighbors = RangeQuery(dna_set, dna_set[i], eps);
-        if (neighbors.size() >= minpts) {
+        if (neighbors[i].size() >= minpts) {
             point_type[i] = 1; // 核心点
-            num_cores++;
+            core_id[i] = num_cores++;
         }
     }
     
-    // 第二步：聚类核心点并形成簇
-    for (int i = 0; i < n; i++) {
-        if (point_type[i] == 1 && !visited[i]) {
-            // 开始新的簇
-            queue<int> q;
-            q.push(i);
-            visited[i] = true;
-            cluster_id[i] = num_clusters;
-            
-            while (!q.empty()) {
-                int current = q.front();
-                q.pop();
-                
-                vector<string> neighbors = RangeQuery(dna_set, dna_set[current], eps);
-                
-                for (const string &neighbor : neighbors) {
-                    // 找到邻居在dna_set中的索引
-                    auto it = find(dna_set.begin(), dna_set.end(), neighbor);
-                    if (it != dna_set.end()) {
-                        int neighbor_idx = distance(dna_set.begin(), it);
-                        
-                        if (!visited[neighbor_idx]) {
-                            visited[neighbor_idx] = true;
-                            cluster_id[neighbor_idx] = num_clusters;
-                            
-                            if (point_type[neighbor_idx] == 1) {
-                                q.push(neighbor_idx);
-                            }
-                        } else if (cluster_id[neighbor_idx] == -1) {
-                            cluster_id[neighbor_idx] = num_clusters;
-                        }
-                    }
-                }
+    // 第二步：相邻的核心点并入同一个集合，各线程边扫描邻居表边合并
+    ConcurrentDSU dsu(num_cores);
+    ParallelFor(n, [&](int i) {
+        if (point_type[i] != 1) return;
+        for (int j : neighbors[i]) {
+            if (j > i && point_type[j] == 1) {
+                dsu.unite(core_id[i], core_id[j]);
             }
-            num_clusters++;
         }
+    });
+    
+    // 簇按其中最小的核心点下标编号，与逐个核心点做 BFS 的编号顺序相同
+    vector<int> root_cluster(num_cores, -1);
+    for (int i = 0; i < n; i++) {
+        if (point_type[i] != 1) continue;
+        int root = dsu.find(core_id[i]);
+        if (root_cluster[root] == -1) {
+            root_cluster[root] = num_clusters++;
+        }
+        cluster_id[i] = root_cluster[root];
     }
     
-    // 第三步：识别边界点和噪声点
+    // 第三步：识别边界点和噪声点，边界点归入相邻核心点中编号最小的簇
     for (int i = 0; i < n; i++) {
-        if (point_type[i] != 1) { // 非核心点
-            bool is_border = false;
-            
-            // 检查是否在某个核心点的邻域内
-            for (int j = 0; j < n; j++) {
-                if (point_type[j] == 1 && LevDist(dna_set[i], dna_set[j]) <= eps) {
-                    point_type[i] = 2; // 边界点
-                    is_border = true;
-                    num_borders++;
-                    break;
-                }
-            }
-            
-            if (!is_border) {
-                point_type[i] = 3; // 噪声点
-                num_outliers++;
+        if (point_type[i] == 1) continue;
+        for (int j : neighbors[i]) {
+            if (point_type[j] == 1 && (cluster_id[i] == -1 || cluster_id[j] < cluster_id[i])) {
+                cluster_id[i] = cluster_id[j];
             }
         }
+        if (cluster_id[i] != -1) {
+            point_type[i] = 2; // 边界点
+            num_borders++;
+        } else {
+            point_type[i] = 3; // 噪声点
+            num_outliers++;
+        }
     }
     
-    // 构建返回的簇集合
-    vector<vector<string>> clusters(num_clusters);
+    // 构建返回的簇集合：按簇号计数排序，簇内下标保持升序
+    IdLists clusters;
+    clusters.offsets.assign(num_clusters + 1, 0);
     for (int i = 0; i < n; i++) {
         if (cluster_id[i] != -1) {
-            clusters[cluster_id[i]].push_back(dna_set[i]);
+            clusters.offsets[cluster_id[i] + 1]++;
+        }
+    }
+    partial_sum(clusters.offsets.begin(), clusters.offsets.end(), clusters.offsets.begin());
+    clusters.ids.resize(clusters.offsets[num_clusters]);
+    vector<int> fill(clusters.offsets.begin(), clusters.offsets.end() - 1);
+    for (int i = 0; i < n; i++) {
+        if (cluster_id[i] != -1) {
+            clusters.ids[fill[cluster_id[i]]++] = i;
         }
     }
     
@@ -188,24 +384,64 @@ vector<vector<string>> DBSCAN(const vector<string> &dna_set,
 }
 
 // 2.5 最小半径计算
+// 每个点到第 k 近的其他点的距离：k = 0 时为 0，其他点不足 k 个时为 INT_MAX。
+// 每对只算一次距离，两端各用一个大小为 k 的大根堆做部分选择
+vector<int> KDistances(const vector<string> &dna_set, int k) {
+    int n = dna_set.size();
+    vector<int> kdist(n, k <= 0 ? 0 : INT_MAX);
+    if (k <= 0) return kdist;
+
+    vector<int> heaps((size_t)n * k);
+    vector<int> sizes(n, 0);
+    auto offer = [&](int x, int d) {
+        int *heap = heaps.data() + (size_t)x * k;
+        if (sizes[x] < k) {
+            heap[sizes[x]++] = d;
+            push_heap(heap, heap + sizes[x]);
+        } else if (d < heap[0]) {
+            pop_heap(heap, heap + k);
+            heap[k - 1] = d;
+            push_heap(heap, heap + k);
+        }
+    };
+    for (int i = 0; i < n; i++) {
+        for (int j = i + 1; j < n; j++) {
+            int d = LevDist(dna_set[i], dna_set[j]);
+            offer(i, d);
+            offer(j, d);
+        }
+    }
+    for (int x = 0; x < n; x++) {
+        if (sizes[x] == k) kdist[x] = heaps[(size_t)x * k];
+    }
+    return kdist;
+}
+
+// x 不是离群点当且仅当 x 是核心点 (kdist(x) <= eps)，或者某个核心点 y 满足 d(x, y) <= eps，
+// 所以让 x 不成为离群点的最小 eps 是 need(x) = min(kdist(x), min_y max(kdist(y), d(x, y)))，
+// 答案是所有 need 的最大值（且至少为 1）。按 kdist 从大到小处理，kdist 不超过当前答案的点
+// 不会再改变结果；其余点只需对 kdist(y) < need(x) 的 y 做带阈值的距离检查。
+// minpts 超过点数时没有核心点，不存在这样的 eps，返回 -1
 int MinEPS(const vector<string> &dna_set, int minpts) {
+    int n = dna_set.size();
+    if (minpts > n) return -1;
+    vector<int> kdist = KDistances(dna_set, minpts - 1);
+
+    vector<int> order(n);
+    iota(order.begin(), order.end(), 0);
+    sort(order.begin(), order.end(), [&](int x, int y) { return kdist[x] > kdist[y]; });
+
     int eps = 1;
-    
-    while (true) {
-        int num_cores = 0, num_borders = 0, num_outliers = 0, num_clusters = 0;
-        DBSCAN(dna_set, eps, minpts, num_cores, num_borders, num_outliers, num_clusters);
-        
-        if (num_outliers == 0) {
-            break;
-        }
-        eps++;
-        
-        // 防止无限循环，设置上限
-        if (eps > 1000) {
-            break;
+    for (int x : order) {
+        if (kdist[x] <= eps) break;
+        int need = kdist[x];
+        for (int y = 0; y < n && need > eps; y++) {
+            if (y == x || kdist[y] >= need) continue;
+            int d = LevDistWithin(dna_set[x], dna_set[y], need - 1);
+            need = min(need, max(kdist[y], d));
         }
+        eps = max(eps, need);
     }
-    
     return eps;
 }
 
@@ -218,12 +454,12 @@ int main() {
     cout << edit_dist << endl;
     
     // 2.3 计算相似DNA序列集合
-    vector<string> similar_dnas = RangeQuery(DNAS, DNAS[0], E);
+    vector<int> similar_dnas = RangeQueryIds(DNAS, DNAS[0], E);
     cout << similar_dnas.size() << endl;
     
     // 2.4 DBSCAN
     int num_cores = 0, num_borders = 0, num_outliers = 0, num_clusters = 0;
-    vector<vector<string>> clusters = DBSCAN(DNAS, E, P, num_cores, num_borders, num_outliers, num_clusters);
+    IdLists clusters = DBSCAN(DNAS, E, P, num_cores, num_borders, num_outliers, num_clusters);
     cout << num_cores << " " << num_borders << " " << num_outliers << " " << num_clusters << endl;
     
     // 2.5 最小半径